@@ -5,15 +5,139 @@
 =============================================================================*/
 
 #include "CMCharacterMerger.h"
+#include "CharacterMerger.h"
+#include "CMCharacterMergerStats.h"
+#include "CMMeshOptimization.h"
 #include "GPUSkinPublicDefs.h"
 #include "RawIndexBuffer.h"
+#include "TextureResource.h"
 #include "Animation/MorphTarget.h"
 #include "Animation/Skeleton.h"
+#include "Async/ParallelFor.h"
 #include "Engine/SkeletalMesh.h"
 #include "Engine/SkeletalMeshSocket.h"
+#include "Engine/Texture2D.h"
+#include "Materials/Material.h"
+#include "Materials/MaterialExpressionCustom.h"
+#include "Materials/MaterialExpressionTextureCoordinate.h"
+#include "Materials/MaterialExpressionTextureSample.h"
+#include "Materials/MaterialExpressionVertexColor.h"
+#include "Materials/MaterialInstanceDynamic.h"
 #include "Rendering/SkeletalMeshRenderData.h"
 #include "Rendering/SkeletalMeshLODRenderData.h"
 
+DEFINE_STAT(STAT_CharacterMerger_DoMerge);
+DEFINE_STAT(STAT_CharacterMerger_MergeSkeleton);
+DEFINE_STAT(STAT_CharacterMerger_FinalizeMesh);
+DEFINE_STAT(STAT_CharacterMerger_BuildReferenceSkeleton);
+DEFINE_STAT(STAT_CharacterMerger_BuildSockets);
+DEFINE_STAT(STAT_CharacterMerger_PruneBones);
+DEFINE_STAT(STAT_CharacterMerger_GenerateLODModel);
+DEFINE_STAT(STAT_CharacterMerger_GenerateNewSectionArray);
+DEFINE_STAT(STAT_CharacterMerger_CopyVertices);
+DEFINE_STAT(STAT_CharacterMerger_RemapIndices);
+DEFINE_STAT(STAT_CharacterMerger_WeldVertices);
+DEFINE_STAT(STAT_CharacterMerger_HideTriangles);
+DEFINE_STAT(STAT_CharacterMerger_OptimizeVertexCache);
+DEFINE_STAT(STAT_CharacterMerger_Simplify);
+DEFINE_STAT(STAT_CharacterMerger_ParseMorphs);
+DEFINE_STAT(STAT_CharacterMerger_ProcessMergeMesh);
+DEFINE_STAT(STAT_CharacterMerger_InitResources);
+DEFINE_STAT(STAT_CharacterMerger_BuildTextureAtlas);
+
+DEFINE_STAT(STAT_CharacterMerger_NumMerges);
+DEFINE_STAT(STAT_CharacterMerger_NumSections);
+DEFINE_STAT(STAT_CharacterMerger_NumVertices);
+DEFINE_STAT(STAT_CharacterMerger_NumIndices);
+DEFINE_STAT(STAT_CharacterMerger_NumMorphDeltas);
+DEFINE_STAT(STAT_CharacterMerger_NumWeldedVertices);
+DEFINE_STAT(STAT_CharacterMerger_NumHiddenTriangles);
+DEFINE_STAT(STAT_CharacterMerger_NumSimplifiedTriangles);
+DEFINE_STAT(STAT_CharacterMerger_NumPrunedBones);
+DEFINE_STAT(STAT_CharacterMerger_NumCacheMissesBefore);
+DEFINE_STAT(STAT_CharacterMerger_NumCacheMissesAfter);
+DEFINE_STAT(STAT_CharacterMerger_NumBytes);
+DEFINE_STAT(STAT_CharacterMerger_ScratchArenaPeak);
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+DEFINE_STAT(STAT_CharacterMergerLLM_MergeScratch);
+DEFINE_STAT(STAT_CharacterMergerLLM_MergedLODRenderData);
+DEFINE_STAT(STAT_CharacterMergerLLM_MergedMorphTargets);
+DEFINE_STAT(STAT_CharacterMergerLLM_Summary);
+
+void RegisterCharacterMergerLLMTags()
+{
+	FLowLevelMemTracker& MemTracker = FLowLevelMemTracker::Get();
+	const FName SummaryStatName = GET_STATFNAME(STAT_CharacterMergerLLM_Summary);
+
+	MemTracker.RegisterProjectTag((int32)ECMLLMTag::MergeScratch, TEXT("CMMergeScratch"), GET_STATFNAME(STAT_CharacterMergerLLM_MergeScratch), SummaryStatName);
+	MemTracker.RegisterProjectTag((int32)ECMLLMTag::MergedLODRenderData, TEXT("CMMergedLODRenderData"), GET_STATFNAME(STAT_CharacterMergerLLM_MergedLODRenderData), SummaryStatName);
+	MemTracker.RegisterProjectTag((int32)ECMLLMTag::MergedMorphTargets, TEXT("CMMergedMorphTargets"), GET_STATFNAME(STAT_CharacterMergerLLM_MergedMorphTargets), SummaryStatName);
+}
+#endif
+
+/*-----------------------------------------------------------------------------
+	FCMSkelMeshMergeStats
+-----------------------------------------------------------------------------*/
+
+const TCHAR* FCMSkelMeshMergeStats::GetPhaseName(ECMMergePhase Phase)
+{
+	switch (Phase)
+	{
+	case ECMMergePhase::BuildReferenceSkeleton:		return TEXT("BuildReferenceSkeleton");
+	case ECMMergePhase::BuildSockets:				return TEXT("BuildSockets");
+	case ECMMergePhase::PruneBones:					return TEXT("PruneBones");
+	case ECMMergePhase::GenerateNewSectionArray:	return TEXT("GenerateNewSectionArray");
+	case ECMMergePhase::CopyVertices:				return TEXT("CopyVertices");
+	case ECMMergePhase::RemapIndices:				return TEXT("RemapIndices");
+	case ECMMergePhase::WeldVertices:				return TEXT("WeldVertices");
+	case ECMMergePhase::HideTriangles:				return TEXT("HideTriangles");
+	case ECMMergePhase::Simplify:					return TEXT("Simplify");
+	case ECMMergePhase::OptimizeVertexCache:		return TEXT("OptimizeVertexCache");
+	case ECMMergePhase::ParseMorphs:				return TEXT("ParseMorphs");
+	case ECMMergePhase::InitResources:				return TEXT("InitResources");
+	default:										return TEXT("Unknown");
+	}
+}
+
+/**
+* Keeps the scratch arena peak stat at the largest arena usage seen by any merge
+*/
+static void UpdateScratchArenaPeakStat(int64 ScratchBytes)
+{
+	static int64 ScratchArenaPeak = 0;
+	if (ScratchBytes > ScratchArenaPeak)
+	{
+		ScratchArenaPeak = ScratchBytes;
+		SET_MEMORY_STAT(STAT_CharacterMerger_ScratchArenaPeak, ScratchArenaPeak);
+	}
+}
+
+/**
+* Fills the per-stream memory of a single LOD
+*/
+static void GetLODMemory(const FSkeletalMeshLODRenderData& LODData, FCMSkelMeshLODMemory& OutMemory)
+{
+	const FStaticMeshVertexBuffers& VertexBuffers = LODData.StaticVertexBuffers;
+
+	OutMemory.Positions = (int64)VertexBuffers.PositionVertexBuffer.GetNumVertices() * VertexBuffers.PositionVertexBuffer.GetStride();
+	OutMemory.Tangents = VertexBuffers.StaticMeshVertexBuffer.GetTangentSize();
+	OutMemory.TexCoords = VertexBuffers.StaticMeshVertexBuffer.GetTexCoordSize();
+	OutMemory.Colors = (int64)VertexBuffers.ColorVertexBuffer.GetNumVertices() * VertexBuffers.ColorVertexBuffer.GetStride();
+	OutMemory.SkinWeights = LODData.SkinWeightVertexBuffer.GetVertexDataSize();
+	if (LODData.MultiSizeIndexContainer.IsIndexBufferValid())
+	{
+		OutMemory.Indices = (int64)LODData.MultiSizeIndexContainer.GetIndexBuffer()->Num() * LODData.MultiSizeIndexContainer.GetDataTypeSize();
+	}
+
+	OutMemory.DuplicatedVertices = 0;
+	for (const FSkelMeshRenderSection& Section : LODData.RenderSections)
+	{
+		OutMemory.DuplicatedVertices += (int64)Section.DuplicatedVerticesBuffer.DupVertData.Num() * sizeof(uint32);
+		OutMemory.DuplicatedVertices += (int64)Section.DuplicatedVerticesBuffer.DupVertIndexData.Num() * sizeof(FIndexLengthPair);
+	}
+}
+
 /*-----------------------------------------------------------------------------
 	FCMSkeletalMeshMerge
 -----------------------------------------------------------------------------*/
@@ -29,13 +153,17 @@ FCMSkeletalMeshMerge::FCMSkeletalMeshMerge(USkeletalMesh* InMergeMesh,
 									   const TArray<FCMSkelMeshMergeSectionMapping>& InForceSectionMapping,
 									   int32 InStripTopLODs,
                                        EMeshBufferAccess InMeshBufferAccess,
-									   FCMSkelMeshMergeUVTransforms* InSectionUVTransforms)
+									   FCMSkelMeshMergeUVTransforms* InSectionUVTransforms,
+									   const FCMSkelMeshMergeOptions& InOptions)
 :	MergeMesh(InMergeMesh)
 ,	SrcMeshList(InSrcMeshList)
 ,	StripTopLODs(InStripTopLODs)
 ,   MeshBufferAccess(InMeshBufferAccess)
 ,	ForceSectionMapping(InForceSectionMapping)
 ,	SectionUVTransforms(InSectionUVTransforms)
+,	Options(InOptions)
+,	MergedVertexBounds(ForceInit)
+,	bMergeMaterialInstances(false)
 {
 	check(MergeMesh);
 }
@@ -72,112 +200,271 @@ struct FCompareMorphTargetDeltas
 	}
 };
 
-void ParseMorphs(USkeletalMesh* Source, USkeletalMesh* Target, int32 SourceInTargetSection)
+/**
+* Appends the deltas of one LOD of the morph targets of 'Source' to a LOD of 'Target'
+* @param SourceLODIdx - LOD of the source morph targets
+* @param SrcVertexToMergedVertex - merged vertex index of every source vertex of that LOD
+* @param SrcVertexOwnsMergedVertex - whether every source vertex of that LOD owns its merged vertex
+* @param TargetLODIdx - LOD of the target morph targets to append to
+* @param Options - merge options, the morph targets it bakes or doesn't allow are skipped
+* @param OutCollapsedDeltas - deltas of the vertices that don't own their merged vertex, per morph target, resolved by FinalizeMorphLOD
+* @param OutNumPrunedDeltas - incremented by the number of source deltas left out
+* @return number of morph deltas added to the target and to OutCollapsedDeltas
+*/
+static int32 ParseMorphs(USkeletalMesh* Source, int32 SourceLODIdx, TArrayView<const int32> SrcVertexToMergedVertex, TArrayView<const bool> SrcVertexOwnsMergedVertex, USkeletalMesh* Target, int32 TargetLODIdx,
+	const FCMSkelMeshMergeOptions& Options, TMap<FName, TArray<FMorphTargetDelta>>& OutCollapsedDeltas, int32& OutNumPrunedDeltas)
 {
-	FSkeletalMeshLODRenderData& RenderData = Target->GetResourceForRendering()->LODRenderData[0];
+	int32 NumAddedDeltas = 0;
 
-	int32 PrevSectionsVertices = 0;
-	for(int It = 0; It < SourceInTargetSection; It++)
-	{
-		PrevSectionsVertices += RenderData.RenderSections[It].GetNumVertices();
-	}
-	
-	/**Collect morph targets data from source*/
-	TMap<FName, TArray<FMorphTargetDelta>> SourceMorphTargets;
+	/**Create new morph target objects*/
+	TArray<UMorphTarget*> MorphTargetObjects;
 	for(const UMorphTarget* SourceMT : Source->GetMorphTargets())
 	{
-		FName SourceMTName = SourceMT->GetFName();
-		SourceMorphTargets.Add(SourceMTName);
-		
-		for(FMorphTargetDelta TargetDelta : SourceMT->MorphLODModels[0].Vertices)
+		if(!SourceMT->MorphLODModels.IsValidIndex(SourceLODIdx))
 		{
-			TargetDelta.SourceIdx += PrevSectionsVertices;
-			SourceMorphTargets[SourceMTName].Add(TargetDelta);
+			continue;
 		}
-	}
 
-	/**Collect morphs from target*/
-	TArray<FName> ExistingMorphs;
-	for(const UMorphTarget* TargetMT : Target->GetMorphTargets())
-	{
-		FName TargetMTName = TargetMT->GetFName();
-		ExistingMorphs.Add(TargetMTName);
-	}
+		const FName SourceMTName = SourceMT->GetFName();
+		const TArray<FMorphTargetDelta>& SourceDeltas = SourceMT->MorphLODModels[SourceLODIdx].Vertices;
+		if (Options.BakedMorphWeights.Contains(SourceMTName))
+		{
+			// already applied to the merged vertices
+			continue;
+		}
+		if (Options.MorphTargetAllowList.Num() > 0 && !Options.MorphTargetAllowList.Contains(SourceMTName))
+		{
+			OutNumPrunedDeltas += SourceDeltas.Num();
+			continue;
+		}
 
-	/**Create new morph target objects*/
-	TArray<UMorphTarget*> MorphTargetObjects;
-	for(const TTuple<FName, TArray<FMorphTargetDelta>>& MorphTarget : SourceMorphTargets)
-	{
+		/**Check, if morph with this target is already exist (for ex, in other meshes)*/
 		UMorphTarget* NewMorphTarget = nullptr;
+		for(UMorphTarget* It : Target->GetMorphTargets())
+		{
+			if(It->GetFName() == SourceMTName)
+			{
+				NewMorphTarget = It;
+				break;
+			}
+		}
 
-		/**Check, if morph with this target is already exist (for ex, in other meshes)*/
-		if(!ExistingMorphs.Contains(MorphTarget.Key))
+		if(NewMorphTarget == nullptr)
 		{
-			NewMorphTarget = NewObject<UMorphTarget>(Target, MorphTarget.Key);
-			NewMorphTarget->MorphLODModels.AddDefaulted(1);
+			NewMorphTarget = NewObject<UMorphTarget>(Target, SourceMTName);
 			MorphTargetObjects.Add(NewMorphTarget);
 		}
-		else
+
+		if(NewMorphTarget->MorphLODModels.Num() <= TargetLODIdx)
 		{
-			/**Search existing MT*/
-			for(UMorphTarget* It : Target->GetMorphTargets())
-			{
-				if(It->GetFName() == MorphTarget.Key)
-				{
-					NewMorphTarget = It;
-					break;
-				}
-			}
+			NewMorphTarget->MorphLODModels.SetNum(TargetLODIdx + 1);
 		}
-		
-		// morph mesh data to modify
-		FMorphTargetLODModel& MorphModel = NewMorphTarget->MorphLODModels[0];
-		// copy the wedge point indices
-		// for now just keep every thing 
 
-		//Increase MorphModel vertex num
-		MorphModel.NumBaseMeshVerts += MorphTarget.Value.Num();
+		// morph mesh data to modify
+		FMorphTargetLODModel& MorphModel = NewMorphTarget->MorphLODModels[TargetLODIdx];
+		MorphModel.Vertices.Reserve(MorphModel.Vertices.Num() + SourceDeltas.Num());
 
 		// mark if generated by reduction setting, so that we can remove them later if we want to
 		// we don't want to delete if it has been imported
 		MorphModel.bGeneratedByEngine = true;
 
 		// Still keep this (could remove in long term due to incoming data)
-		for (const FMorphTargetDelta& Delta : MorphTarget.Value)
+		for (const FMorphTargetDelta& SourceDelta : SourceDeltas)
 		{
-			if (Delta.PositionDelta.SizeSquared() > FMath::Square(THRESH_POINTS_ARE_NEAR))
+			if (!SrcVertexToMergedVertex.IsValidIndex(SourceDelta.SourceIdx) ||
+				SrcVertexToMergedVertex[SourceDelta.SourceIdx] == INDEX_NONE)
 			{
-				MorphModel.Vertices.Add(Delta);
-				for (int32 SectionIdx = 0; SectionIdx < RenderData.RenderSections.Num(); ++SectionIdx)
-				{
-					if (MorphModel.SectionIndices.Contains(SectionIdx))
-					{
-						continue;
-					}
-						
-					/**Vertex mapping, if this is not a first section -> move it to NewSection.first value*/
-					const uint32 BaseVertexBufferIndex = (uint32)(RenderData.RenderSections[SectionIdx].GetVertexBufferIndex());
-					const uint32 LastVertexBufferIndex = (uint32)(BaseVertexBufferIndex + RenderData.RenderSections[SectionIdx].GetNumVertices());
-					if (BaseVertexBufferIndex <= Delta.SourceIdx && Delta.SourceIdx < LastVertexBufferIndex)
-					{
-						MorphModel.SectionIndices.AddUnique(SectionIdx);
-						break;
-					}
-				}
+				continue;
+			}
+
+			// move the delta to where its vertex ended up in the merged vertex buffer, collapsed vertices only fill in for their owners
+			TArray<FMorphTargetDelta>& Deltas = SrcVertexOwnsMergedVertex[SourceDelta.SourceIdx] ? MorphModel.Vertices : OutCollapsedDeltas.FindOrAdd(SourceMTName);
+			FMorphTargetDelta& Delta = Deltas.Add_GetRef(SourceDelta);
+			Delta.SourceIdx = SrcVertexToMergedVertex[SourceDelta.SourceIdx];
+			NumAddedDeltas++;
+		}
+	}
+	MorphTargetObjects.Append(Target->GetMorphTargets());
+
+	Target->SetMorphTargets(MorphTargetObjects);
+
+	return NumAddedDeltas;
+}
+
+/**
+* Removes the morph targets of 'Target' that were left without deltas in every LOD once pruned.
+* @return number of morph targets kept
+*/
+static int32 RemoveEmptyMorphTargets(USkeletalMesh* Target)
+{
+	TArray<UMorphTarget*> MorphTargetObjects = Target->GetMorphTargets();
+	const int32 NumRemoved = MorphTargetObjects.RemoveAll([](const UMorphTarget* MorphTarget)
+	{
+		for (const FMorphTargetLODModel& MorphModel : MorphTarget->MorphLODModels)
+		{
+			if (MorphModel.Vertices.Num() > 0)
+			{
+				return false;
 			}
 		}
+		return true;
+	});
+
+	if (NumRemoved > 0)
+	{
+		Target->SetMorphTargets(MorphTargetObjects);
+	}
+	return MorphTargetObjects.Num();
+}
+
+/**
+* Sorts the deltas of a merged LOD of every morph target of 'Target' once all source meshes were parsed, then prunes the negligible ones.
+* A merged vertex keeps the delta of its first owning source vertex, vertices welded together being identical.
+* The delta of a source vertex simplification collapsed into it is only used when none of its owners has one.
+* @param CollapsedDeltas - deltas of the source vertices that don't own their merged vertex, per morph target
+* @param Options - merge options, their thresholds prune the deltas
+* @param OutNumPrunedDeltas - incremented by the number of negligible deltas removed
+* @return number of duplicate and negligible deltas removed
+*/
+static int32 FinalizeMorphLOD(USkeletalMesh* Target, int32 TargetLODIdx, const TMap<FName, TArray<FMorphTargetDelta>>& CollapsedDeltas, const FCMSkelMeshMergeOptions& Options, int32& OutNumPrunedDeltas)
+{
+	int32 NumRemovedDeltas = 0;
+	const float PositionThresholdSquared = FMath::Square(Options.MorphPositionThreshold);
+	const float TangentThresholdSquared = FMath::Square(Options.MorphTangentThreshold);
+	const float TangentToleranceSquared = FMath::Square(Options.MorphTangentTolerance);
+
+	const FSkeletalMeshLODRenderData& RenderData = Target->GetResourceForRendering()->LODRenderData[TargetLODIdx];
+
+	for(UMorphTarget* MorphTarget : Target->GetMorphTargets())
+	{
+		if(!MorphTarget->MorphLODModels.IsValidIndex(TargetLODIdx))
+		{
+			continue;
+		}
+
+		FMorphTargetLODModel& MorphModel = MorphTarget->MorphLODModels[TargetLODIdx];
+		MorphModel.NumBaseMeshVerts = RenderData.GetNumVertices();
+
+		// collapsed deltas go after the owned ones, so the stable sort keeps them behind the owned delta of the same vertex
+		if (const TArray<FMorphTargetDelta>* MorphCollapsedDeltas = CollapsedDeltas.Find(MorphTarget->GetFName()))
+		{
+			MorphModel.Vertices.Append(*MorphCollapsedDeltas);
+		}
 
 		// sort the array of vertices for this morph target based on the base mesh indices
 		// that each vertex is associated with. This allows us to sequentially traverse the list
 		// when applying the morph blends to each vertex.
-		MorphModel.Vertices.Sort(FCompareMorphTargetDeltas());
+		MorphModel.Vertices.StableSort(FCompareMorphTargetDeltas());
+
+		// keep the first delta of every vertex, drop the negligible ones and find the sections touched by the morph
+		MorphModel.SectionIndices.Reset();
+		int32 NumDeltas = 0;
+		int32 SectionIdx = 0;
+		int32 PrevSourceIdx = INDEX_NONE;
+		for (int32 DeltaIdx = 0; DeltaIdx < MorphModel.Vertices.Num(); DeltaIdx++)
+		{
+			FMorphTargetDelta Delta = MorphModel.Vertices[DeltaIdx];
+			if ((int32)Delta.SourceIdx == PrevSourceIdx)
+			{
+				continue;
+			}
+			PrevSourceIdx = Delta.SourceIdx;
+
+			const float TangentDeltaSquared = Delta.TangentZDelta.SizeSquared();
+			if (Delta.PositionDelta.SizeSquared() <= PositionThresholdSquared && TangentDeltaSquared <= TangentThresholdSquared)
+			{
+				OutNumPrunedDeltas++;
+				continue;
+			}
+			if (TangentDeltaSquared < TangentToleranceSquared)
+			{
+				Delta.TangentZDelta = FVector::ZeroVector;
+			}
+			MorphModel.Vertices[NumDeltas++] = Delta;
+
+			// deltas are sorted, so the section only moves forward
+			while (SectionIdx < RenderData.RenderSections.Num() &&
+				Delta.SourceIdx >= RenderData.RenderSections[SectionIdx].BaseVertexIndex + RenderData.RenderSections[SectionIdx].NumVertices)
+			{
+				SectionIdx++;
+			}
+			if (SectionIdx < RenderData.RenderSections.Num())
+			{
+				MorphModel.SectionIndices.AddUnique(SectionIdx);
+			}
+		}
+		NumRemovedDeltas += MorphModel.Vertices.Num() - NumDeltas;
+		MorphModel.Vertices.SetNum(NumDeltas, false);
 
 		// remove array slack
 		MorphModel.Vertices.Shrink();
 	}
-	MorphTargetObjects.Append(Target->GetMorphTargets());
 
-	Target->SetMorphTargets(MorphTargetObjects);
+	return NumRemovedDeltas;
+}
+
+void FCMSkeletalMeshMerge::GetMemoryBreakdown(const USkeletalMesh* Mesh, FCMSkelMeshMemoryBreakdown& OutBreakdown)
+{
+	OutBreakdown = FCMSkelMeshMemoryBreakdown();
+	if (!Mesh)
+	{
+		return;
+	}
+
+	USkeletalMesh* MutableMesh = const_cast<USkeletalMesh*>(Mesh);
+	if (const FSkeletalMeshRenderData* Resource = MutableMesh->GetResourceForRendering())
+	{
+		OutBreakdown.LODs.AddDefaulted(Resource->LODRenderData.Num());
+		for (int32 LODIdx = 0; LODIdx < Resource->LODRenderData.Num(); LODIdx++)
+		{
+			GetLODMemory(Resource->LODRenderData[LODIdx], OutBreakdown.LODs[LODIdx]);
+		}
+	}
+
+	for (const UMorphTarget* MorphTarget : Mesh->GetMorphTargets())
+	{
+		if (MorphTarget)
+		{
+			for (const FMorphTargetLODModel& MorphModel : MorphTarget->MorphLODModels)
+			{
+				OutBreakdown.MorphTargets += MorphModel.Vertices.GetAllocatedSize() + MorphModel.SectionIndices.GetAllocatedSize();
+			}
+		}
+	}
+
+	for (USkeletalMeshSocket* Socket : MutableMesh->GetMeshOnlySocketList())
+	{
+		if (Socket)
+		{
+			OutBreakdown.Sockets += Socket->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+		}
+	}
+}
+
+int32 FCMSkeletalMeshMerge::GetSectionMaterialIndex(const USkeletalMesh* Mesh, int32 LODIdx, int32 SectionIdx)
+{
+	const FSkeletalMeshRenderData* Resource = const_cast<USkeletalMesh*>(Mesh)->GetResourceForRendering();
+	int32 MaterialIndex = Resource->LODRenderData[LODIdx].RenderSections[SectionIdx].MaterialIndex;
+
+	// use the remapping of material indices if there is a valid value
+	const FSkeletalMeshLODInfo* LODInfo = Mesh->GetLODInfo(LODIdx);
+	if (LODInfo && LODInfo->LODMaterialMap.IsValidIndex(SectionIdx) && LODInfo->LODMaterialMap[SectionIdx] != INDEX_NONE && Mesh->GetMaterials().Num() > 0)
+	{
+		MaterialIndex = FMath::Clamp<int32>(LODInfo->LODMaterialMap[SectionIdx], 0, Mesh->GetMaterials().Num() - 1);
+	}
+	return MaterialIndex;
+}
+
+UMaterialInterface* FCMSkeletalMeshMerge::GetStaticPermutationMaterial(UMaterialInterface* Material)
+{
+	// instances without static switch or component mask overrides draw with the shaders of their parent
+	UMaterialInstance* Instance = Cast<UMaterialInstance>(Material);
+	while (Instance && !Instance->bHasStaticPermutationResource && Instance->Parent)
+	{
+		Material = Instance->Parent;
+		Instance = Cast<UMaterialInstance>(Material);
+	}
+	return Material;
 }
 
 /**
@@ -187,6 +474,9 @@ void ParseMorphs(USkeletalMesh* Source, USkeletalMesh* Target, int32 SourceInTar
 */
 bool FCMSkeletalMeshMerge::DoMerge(TArray<FCMRefPoseOverride>* RefPoseOverrides /* = nullptr */)
 {
+	CM_SCOPE_CYCLE_COUNTER(STAT_CharacterMerger_DoMerge);
+	INC_DWORD_STAT(STAT_CharacterMerger_NumMerges);
+
 	MergeSkeleton(RefPoseOverrides);
 
 	return FinalizeMesh();
@@ -194,6 +484,11 @@ bool FCMSkeletalMeshMerge::DoMerge(TArray<FCMRefPoseOverride>* RefPoseOverrides
 
 void FCMSkeletalMeshMerge::MergeSkeleton(const TArray<FCMRefPoseOverride>* RefPoseOverrides /* = nullptr */)
 {
+	CM_SCOPE_CYCLE_COUNTER(STAT_CharacterMerger_MergeSkeleton);
+
+	MergeStats.Reset();
+	MergedVertexBounds.Init();
+
 	// Release the rendering resources.
 
 	MergeMesh->ReleaseResources();
@@ -201,8 +496,14 @@ void FCMSkeletalMeshMerge::MergeSkeleton(const TArray<FCMRefPoseOverride>* RefPo
 
 	// Build the reference skeleton & sockets.
 
-	BuildReferenceSkeleton(SrcMeshList, NewRefSkeleton, MergeMesh->GetSkeleton());
-	BuildSockets(SrcMeshList);
+	{
+		CM_SCOPE_MERGE_PHASE(STAT_CharacterMerger_BuildReferenceSkeleton, BuildReferenceSkeleton);
+		BuildReferenceSkeleton(SrcMeshList, NewRefSkeleton, MergeMesh->GetSkeleton());
+	}
+	{
+		CM_SCOPE_MERGE_PHASE(STAT_CharacterMerger_BuildSockets, BuildSockets);
+		BuildSockets(SrcMeshList);
+	}
 
 	// Override the reference bone poses & sockets, if specified.
 
@@ -212,6 +513,15 @@ void FCMSkeletalMeshMerge::MergeSkeleton(const TArray<FCMRefPoseOverride>* RefPo
 		OverrideMergedSockets(*RefPoseOverrides);
 	}
 
+	// Drop the bones nothing is skinned or attached to.
+
+	MergeStats.NumRefBonesBeforePruning = MergeStats.NumRefBones = NewRefSkeleton.GetRawBoneNum();
+	if (Options.bPruneUnweightedBones)
+	{
+		CM_SCOPE_MERGE_PHASE(STAT_CharacterMerger_PruneBones, PruneBones);
+		PruneUnweightedBones(NewRefSkeleton, MergeMesh->GetSkeleton());
+	}
+
 	// Assign new referencer skeleton.
 
 	MergeMesh->SetRefSkeleton(NewRefSkeleton);
@@ -225,6 +535,8 @@ void FCMSkeletalMeshMerge::MergeSkeleton(const TArray<FCMRefPoseOverride>* RefPo
 
 bool FCMSkeletalMeshMerge::FinalizeMesh()
 {
+	CM_SCOPE_CYCLE_COUNTER(STAT_CharacterMerger_FinalizeMesh);
+
 	bool Result = true;
 
 	// Find the common maximum number of LODs available in the list of source meshes.
@@ -239,41 +551,53 @@ bool FCMSkeletalMeshMerge::FinalizeMesh()
 
 	ReleaseResources(MaxNumLODs);
 
+	MergedMaterialInstances.Reset();
+	const int32 InstanceIndexUVChannel = Options.MaterialInstanceMerge.InstanceIndexUVChannel;
+	bMergeMaterialInstances = Options.bMergeMaterialInstances;
+	if (bMergeMaterialInstances && (InstanceIndexUVChannel < 0 || InstanceIndexUVChannel >= MAX_TEXCOORDS))
+	{
+		UE_LOG(LogCharacterMerger, Warning, TEXT("Material instances aren't merged, the instance index UV channel %d isn't a valid channel"), InstanceIndexUVChannel);
+		bMergeMaterialInstances = false;
+	}
+
 	// Create a mapping from each input mesh bone to bones in the merged mesh.
 
 	SrcMeshInfo.Empty();
-	SrcMeshInfo.AddZeroed(SrcMeshList.Num());
-
-	for (int32 MeshIdx = 0; MeshIdx < SrcMeshList.Num(); MeshIdx++)
 	{
-		USkeletalMesh* SrcMesh = SrcMeshList[MeshIdx];
-		if (SrcMesh)
+		CM_LLM_SCOPE(MergeScratch);
+		SrcMeshInfo.AddZeroed(SrcMeshList.Num());
+
+		for (int32 MeshIdx = 0; MeshIdx < SrcMeshList.Num(); MeshIdx++)
 		{
-			if (SrcMesh->GetHasVertexColors())
+			USkeletalMesh* SrcMesh = SrcMeshList[MeshIdx];
+			if (SrcMesh)
 			{
-				MergeMesh->SetHasVertexColors(true);
+				if (SrcMesh->GetHasVertexColors())
+				{
+					MergeMesh->SetHasVertexColors(true);
 #if WITH_EDITORONLY_DATA
-				MergeMesh->SetVertexColorGuid(FGuid::NewGuid());
+					MergeMesh->SetVertexColorGuid(FGuid::NewGuid());
 #endif
-			}
-
-			FMergeMeshInfo& MeshInfo = SrcMeshInfo[MeshIdx];
-			MeshInfo.SrcToDestRefSkeletonMap.AddUninitialized(SrcMesh->GetRefSkeleton().GetRawBoneNum());
+				}
 
-			for (int32 i = 0; i < SrcMesh->GetRefSkeleton().GetRawBoneNum(); i++)
-			{
-				FName SrcBoneName = SrcMesh->GetRefSkeleton().GetBoneName(i);
-				int32 DestBoneIndex = NewRefSkeleton.FindBoneIndex(SrcBoneName);
+				FMergeMeshInfo& MeshInfo = SrcMeshInfo[MeshIdx];
+				MeshInfo.SrcToDestRefSkeletonMap.AddUninitialized(SrcMesh->GetRefSkeleton().GetRawBoneNum());
 
-				if (DestBoneIndex == INDEX_NONE)
+				for (int32 i = 0; i < SrcMesh->GetRefSkeleton().GetRawBoneNum(); i++)
 				{
-					// Missing bones shouldn't be possible, but can happen with invalid meshes;
-					// map any bone we are missing to the 'root'.
+					FName SrcBoneName = SrcMesh->GetRefSkeleton().GetBoneName(i);
+					int32 DestBoneIndex = NewRefSkeleton.FindBoneIndex(SrcBoneName);
 
-					DestBoneIndex = 0;
-				}
+					if (DestBoneIndex == INDEX_NONE)
+					{
+						// Missing bones shouldn't be possible, but can happen with invalid meshes;
+						// map any bone we are missing to the 'root'.
+
+						DestBoneIndex = 0;
+					}
 
-				MeshInfo.SrcToDestRefSkeletonMap[i] = DestBoneIndex;
+					MeshInfo.SrcToDestRefSkeletonMap[i] = DestBoneIndex;
+				}
 			}
 		}
 	}
@@ -293,19 +617,35 @@ bool FCMSkeletalMeshMerge::FinalizeMesh()
 		// Get the number of UV sets for each LOD.
 		for (int32 MeshIdx = 0; MeshIdx < SrcMeshList.Num(); MeshIdx++)
 		{
-			USkeletalMesh* SrcSkelMesh = SrcMeshList[MeshIdx];
-			FSkeletalMeshRenderData* SrcResource = SrcSkelMesh->GetResourceForRendering();
+			if (SrcMeshList[MeshIdx] == nullptr)
+			{
+				continue;
+			}
 
 			for (int32 LODIdx = 0; LODIdx < MaxNumLODs; LODIdx++)
 			{
-				if (SrcResource->LODRenderData.IsValidIndex(LODIdx))
-				{
-					uint32& NumUVSets = PerLODNumUVSets[LODIdx];
-					NumUVSets = FMath::Max(NumUVSets, SrcResource->LODRenderData[LODIdx].GetNumTexCoords());
+				// parts with fewer LODs contribute the LOD they are merged with
+				const FSkeletalMeshLODRenderData& SrcLODData = GetSourceLODData(MeshIdx, LODIdx + StripTopLODs);
 
-					PerLODMaxBoneInfluences[LODIdx] = FMath::Max(PerLODMaxBoneInfluences[LODIdx], SrcResource->LODRenderData[LODIdx].GetVertexBufferMaxBoneInfluences());
-					PerLODUse16BitBoneIndex[LODIdx] |= SrcResource->LODRenderData[LODIdx].DoesVertexBufferUse16BitBoneIndex();
+				uint32& NumUVSets = PerLODNumUVSets[LODIdx];
+				NumUVSets = FMath::Max(NumUVSets, SrcLODData.GetNumTexCoords());
+
+				if (bMergeMaterialInstances && SrcLODData.GetNumTexCoords() > (uint32)InstanceIndexUVChannel)
+				{
+					UE_LOG(LogCharacterMerger, Warning, TEXT("Material instances aren't merged, %s uses the instance index UV channel %d"), *SrcMeshList[MeshIdx]->GetName(), InstanceIndexUVChannel);
+					bMergeMaterialInstances = false;
 				}
+
+				PerLODMaxBoneInfluences[LODIdx] = FMath::Max(PerLODMaxBoneInfluences[LODIdx], SrcLODData.GetVertexBufferMaxBoneInfluences());
+				PerLODUse16BitBoneIndex[LODIdx] |= SrcLODData.DoesVertexBufferUse16BitBoneIndex();
+			}
+		}
+
+		if (bMergeMaterialInstances)
+		{
+			for (uint32& NumUVSets : PerLODNumUVSets)
+			{
+				NumUVSets = FMath::Max<uint32>(NumUVSets, InstanceIndexUVChannel + 1);
 			}
 		}
 
@@ -313,9 +653,7 @@ bool FCMSkeletalMeshMerge::FinalizeMesh()
 		MergeMesh->AllocateResourceForRendering();
 		for (int32 LODIdx = 0; LODIdx < MaxNumLODs; LODIdx++)
 		{
-			const FSkeletalMeshLODInfo* LODInfoPtr = MergeMesh->GetLODInfo(LODIdx);
-			bool bUseFullPrecisionUVs = LODInfoPtr ? LODInfoPtr->BuildSettings.bUseFullPrecisionUVs : GVertexElementTypeSupport.IsSupported(VET_Half2) ? false : true;
-			if (!bUseFullPrecisionUVs)
+			if (!UseFullPrecisionUVs(LODIdx + StripTopLODs))
 			{
 				GENERATE_LOD_MODEL(TGPUSkinVertexFloat16Uvs, PerLODNumUVSets[LODIdx]);
 			}
@@ -324,6 +662,12 @@ bool FCMSkeletalMeshMerge::FinalizeMesh()
 				GENERATE_LOD_MODEL(TGPUSkinVertexFloat32Uvs, PerLODNumUVSets[LODIdx]);
 			}
 		}
+		if (bMergeMaterialInstances)
+		{
+			CreateInstanceParameterTables();
+		}
+		MergeStats.NumMorphTargets = RemoveEmptyMorphTargets(MergeMesh);
+
 		// update the merge skel mesh entries
 		if (!ProcessMergeMesh())
 		{
@@ -338,8 +682,11 @@ bool FCMSkeletalMeshMerge::FinalizeMesh()
 		}
 
 		// Reinitialize the mesh's render resources.
-		MergeMesh->InitMorphTargets();
-		MergeMesh->InitResources();
+		{
+			CM_SCOPE_MERGE_PHASE(STAT_CharacterMerger_InitResources, InitResources);
+			MergeMesh->InitMorphTargets();
+			MergeMesh->InitResources();
+		}
 	}
 
 	return Result;
@@ -349,21 +696,21 @@ bool FCMSkeletalMeshMerge::FinalizeMesh()
 * Merge a bonemap with an existing bonemap and keep track of remapping
 * (a bonemap is a list of indices of bones in the USkeletalMesh::RefSkeleton array)
 * @param MergedBoneMap - out merged bonemap
-* @param BoneMapToMergedBoneMap - out of mapping from original bonemap to new merged bonemap 
+* @param BoneMapToMergedBoneMap - out of mapping from original bonemap to new merged bonemap, appended to
 * @param BoneMap - input bonemap to merge
 */
-void FCMSkeletalMeshMerge::MergeBoneMap( TArray<FBoneIndexType>& MergedBoneMap, TArray<FBoneIndexType>& BoneMapToMergedBoneMap, const TArray<FBoneIndexType>& BoneMap )
+void FCMSkeletalMeshMerge::MergeBoneMap( TScratchArray<FBoneIndexType>& MergedBoneMap, TScratchArray<FBoneIndexType>& BoneMapToMergedBoneMap, const TScratchArray<FBoneIndexType>& BoneMap )
 {
-	BoneMapToMergedBoneMap.AddUninitialized( BoneMap.Num() );
+	const int32 StartIdx = BoneMapToMergedBoneMap.AddUninitialized( BoneMap.Num() );
 	for( int32 IdxB=0; IdxB < BoneMap.Num(); IdxB++ )
 	{
-		BoneMapToMergedBoneMap[IdxB] = MergedBoneMap.AddUnique( BoneMap[IdxB] );
+		BoneMapToMergedBoneMap[StartIdx + IdxB] = MergedBoneMap.AddUnique( BoneMap[IdxB] );
 	}
 }
 
-static void BoneMapToNewRefSkel(const TArray<FBoneIndexType>& InBoneMap, const TArray<int32>& SrcToDestRefSkeletonMap, TArray<FBoneIndexType>& OutBoneMap)
+static void BoneMapToNewRefSkel(const TArray<FBoneIndexType>& InBoneMap, const TArray<int32>& SrcToDestRefSkeletonMap, TArray<FBoneIndexType, TMemStackAllocator<>>& OutBoneMap)
 {
-	OutBoneMap.Empty();
+	OutBoneMap.Reset();
 	OutBoneMap.AddUninitialized(InBoneMap.Num());
 
 	for(int32 i=0; i<InBoneMap.Num(); i++)
@@ -373,16 +720,52 @@ static void BoneMapToNewRefSkel(const TArray<FBoneIndexType>& InBoneMap, const T
 	}
 }
 
+/**
+* @return material the sections drawn with Material merge under when material instances are merged, null if it has none
+*/
+static UMaterialInterface* GetInstanceMergeParent( UMaterialInterface* Material )
+{
+	// instances drawing with the same shaders can share a section, even when they aren't instances of the same parent.
+	// static switches compile their own shaders, such an instance can only be the parent of itself and its own instances
+	return FCMSkeletalMeshMerge::GetStaticPermutationMaterial(Material);
+}
+
 /**
 * Generate the list of sections that need to be created along with info needed to merge sections
 * @param NewSectionArray - out array to populate
+* @param BoneMapStorage - out storage referenced by the BoneMapToMergedBoneMap of every merge section, must outlive NewSectionArray
 * @param LODIdx - current LOD to process
 */
-void FCMSkeletalMeshMerge::GenerateNewSectionArray( TArray<FNewSectionInfo>& NewSectionArray, int32 LODIdx )
+void FCMSkeletalMeshMerge::GenerateNewSectionArray( TScratchArray<FNewSectionInfo>& NewSectionArray, TScratchArray<FBoneIndexType>& BoneMapStorage, int32 LODIdx )
 {
+	CM_SCOPE_MERGE_PHASE(STAT_CharacterMerger_GenerateNewSectionArray, GenerateNewSectionArray);
+
 	const int32 MaxGPUSkinBones = FGPUBaseSkinVertexFactory::GetMaxGPUSkinBones();
 
-	NewSectionArray.Empty();
+	// every merge section references a range of BoneMapStorage, so reserve all of it up front to keep those views valid
+	int32 NumSrcSections = 0;
+	int32 NumSrcBoneMapEntries = 0;
+	for( int32 MeshIdx=0; MeshIdx < SrcMeshList.Num(); MeshIdx++ )
+	{
+		if( SrcMeshList[MeshIdx] )
+		{
+			const FSkeletalMeshLODRenderData& SrcLODData = GetSourceLODData(MeshIdx, LODIdx);
+			NumSrcSections += SrcLODData.RenderSections.Num();
+			for( const FSkelMeshRenderSection& Section : SrcLODData.RenderSections )
+			{
+				NumSrcBoneMapEntries += Section.BoneMap.Num();
+			}
+		}
+	}
+
+	NewSectionArray.Reset();
+	NewSectionArray.Reserve(NumSrcSections);
+	BoneMapStorage.Reset();
+	BoneMapStorage.Reserve(NumSrcBoneMapEntries);
+
+	// reused for every source section
+	TScratchArray<FBoneIndexType> DestChunkBoneMap;
+
 	for( int32 MeshIdx=0; MeshIdx < SrcMeshList.Num(); MeshIdx++ )
 	{
 		// source mesh
@@ -391,9 +774,14 @@ void FCMSkeletalMeshMerge::GenerateNewSectionArray( TArray<FNewSectionInfo>& New
 		if( SrcMesh )
 		{
 			FSkeletalMeshRenderData* SrcResource = SrcMesh->GetResourceForRendering();
-			int32 SourceLODIdx = FMath::Min(LODIdx, SrcResource->LODRenderData.Num()-1);
+			int32 SourceLODIdx = GetSourceLODIndex(MeshIdx, LODIdx);
 			FSkeletalMeshLODRenderData& SrcLODData = SrcResource->LODRenderData[SourceLODIdx];
-			FSkeletalMeshLODInfo& SrcLODInfo = *(SrcMesh->GetLODInfo(SourceLODIdx));
+
+			TArrayView<const FTransform> SrcUVTransforms;
+			if (SectionUVTransforms != nullptr && MeshIdx < SectionUVTransforms->UVTransformsPerMesh.Num())
+			{
+				SrcUVTransforms = SectionUVTransforms->UVTransformsPerMesh[MeshIdx];
+			}
 
 			// iterate over each section of this LOD
 			for( int32 SectionIdx=0; SectionIdx < SrcLODData.RenderSections.Num(); SectionIdx++ )
@@ -411,20 +799,29 @@ void FCMSkeletalMeshMerge::GenerateNewSectionArray( TArray<FNewSectionInfo>& New
 				FSkelMeshRenderSection& Section = SrcLODData.RenderSections[SectionIdx];
 
 				// Convert Chunk.BoneMap from src to dest bone indices
-				TArray<FBoneIndexType> DestChunkBoneMap;
 				BoneMapToNewRefSkel(Section.BoneMap, SrcMeshInfo[MeshIdx].SrcToDestRefSkeletonMap, DestChunkBoneMap);
 
 
 				// get the material for this section
-				int32 MaterialIndex = Section.MaterialIndex;
-				// use the remapping of material indices if there is a valid value
-				if(SrcLODInfo.LODMaterialMap.IsValidIndex(SectionIdx) && SrcLODInfo.LODMaterialMap[SectionIdx] != INDEX_NONE && SrcMesh->GetMaterials().Num() > 0)
+				const FSkeletalMaterial& SkeletalMaterial = SrcMesh->GetMaterials()[GetSectionMaterialIndex(SrcMesh, SourceLODIdx, SectionIdx)];
+				UMaterialInterface* Material = SkeletalMaterial.MaterialInterface;
+				if( MaterialId != -1 &&
+					ForceSectionMapping[MeshIdx].SectionMaterials.IsValidIndex(SectionIdx) &&
+					ForceSectionMapping[MeshIdx].SectionMaterials[SectionIdx] != nullptr )
 				{
-					MaterialIndex = FMath::Clamp<int32>( SrcLODInfo.LODMaterialMap[SectionIdx], 0, SrcMesh->GetMaterials().Num() - 1);
+					Material = ForceSectionMapping[MeshIdx].SectionMaterials[SectionIdx];
 				}
 
-				const FSkeletalMaterial& SkeletalMaterial = SrcMesh->GetMaterials()[MaterialIndex];
-				UMaterialInterface* Material = SkeletalMaterial.MaterialInterface;
+				// instances drawing with the same shaders share one section, their vertices tell them apart
+				int32 InstanceIndex = INDEX_NONE;
+				if( bMergeMaterialInstances && MaterialId == -1 )
+				{
+					if( UMaterialInterface* Parent = GetInstanceMergeParent(Material) )
+					{
+						InstanceIndex = MergedMaterialInstances.FindOrAdd(Parent).AddUnique(Material);
+						Material = Parent;
+					}
+				}
 
 				// see if there is an existing entry in the array of new sections that matches its material
 				// if there is a match then the source section can be added to its list of sections to merge 
@@ -438,37 +835,34 @@ void FCMSkeletalMeshMerge::GenerateNewSectionArray( TArray<FNewSectionInfo>& New
 					{
 						check(NewSectionInfo.MergeSections.Num());
 
-						// merge the bonemap from the source section with the existing merged bonemap
-						TArray<FBoneIndexType> TempMergedBoneMap(NewSectionInfo.MergedBoneMap);
-						TArray<FBoneIndexType> TempBoneMapToMergedBoneMap;									
-						MergeBoneMap(TempMergedBoneMap,TempBoneMapToMergedBoneMap,DestChunkBoneMap);
+						// merge the bonemap from the source section with the existing merged bonemap in place
+						const int32 PrevMergedBoneMapNum = NewSectionInfo.MergedBoneMap.Num();
+						const int32 BoneMapOffset = BoneMapStorage.Num();
+						MergeBoneMap(NewSectionInfo.MergedBoneMap,BoneMapStorage,DestChunkBoneMap);
 
 						// check to see if the newly merged bonemap is still within the bone limit for GPU skinning
-						if( TempMergedBoneMap.Num() <= MaxGPUSkinBones )
+						if( NewSectionInfo.MergedBoneMap.Num() <= MaxGPUSkinBones )
 						{
-							TArray<FTransform> SrcUVTransform;
-							if (SectionUVTransforms != nullptr && MeshIdx < SectionUVTransforms->UVTransformsPerMesh.Num())
-							{
-								SrcUVTransform = SectionUVTransforms->UVTransformsPerMesh[MeshIdx];
-							}
-
 							// add the source section as a new merge entry
-							FMergeSectionInfo& MergeSectionInfo = *new(NewSectionInfo.MergeSections) FMergeSectionInfo(
+							// keep track of remapping for the existing chunk's bonemap 
+							// so that the bone matrix indices can be updated for the vertices
+							new(NewSectionInfo.MergeSections) FMergeSectionInfo(
 								SrcMesh,
 								&SrcLODData.RenderSections[SectionIdx],
-								SrcUVTransform
+								MeshIdx,
+								TArrayView<const FBoneIndexType>(BoneMapStorage.GetData() + BoneMapOffset, DestChunkBoneMap.Num()),
+								SrcUVTransforms,
+								InstanceIndex
 								);
-							// keep track of remapping for the existing chunk's bonemap 
-							// so that the bone matrix indices can be updated for the vertices
-							MergeSectionInfo.BoneMapToMergedBoneMap = TempBoneMapToMergedBoneMap;
-
-							// use the updated bonemap for this new section
-							NewSectionInfo.MergedBoneMap = TempMergedBoneMap;
 
 							// keep track of the entry that was found
 							FoundIdx = Idx;
 							break;
 						}
+
+						// over the limit, roll back the merge
+						NewSectionInfo.MergedBoneMap.SetNum(PrevMergedBoneMapNum, false);
+						BoneMapStorage.SetNum(BoneMapOffset, false);
 					}
 				}
 
@@ -483,22 +877,21 @@ void FCMSkeletalMeshMerge::GenerateNewSectionArray( TArray<FNewSectionInfo>& New
 					// initialize the merged bonemap to simply use the original chunk bonemap
 					NewSectionInfo.MergedBoneMap = DestChunkBoneMap;
 
-					TArray<FTransform> SrcUVTransform;
-					if (SectionUVTransforms != nullptr && MeshIdx < SectionUVTransforms->UVTransformsPerMesh.Num())
+					// since merged bonemap == chunk.bonemap then remapping is just pass-through
+					const int32 BoneMapOffset = BoneMapStorage.AddUninitialized( DestChunkBoneMap.Num() );
+					for( int32 i=0; i < DestChunkBoneMap.Num(); i++ )
 					{
-						SrcUVTransform = SectionUVTransforms->UVTransformsPerMesh[MeshIdx];
+						BoneMapStorage[BoneMapOffset + i] = (FBoneIndexType)i;
 					}
+
 					// add a new merge section entry
-					FMergeSectionInfo& MergeSectionInfo = *new(NewSectionInfo.MergeSections) FMergeSectionInfo(
+					new(NewSectionInfo.MergeSections) FMergeSectionInfo(
 						SrcMesh,
 						&SrcLODData.RenderSections[SectionIdx],
-						SrcUVTransform);
-					// since merged bonemap == chunk.bonemap then remapping is just pass-through
-					MergeSectionInfo.BoneMapToMergedBoneMap.Empty( DestChunkBoneMap.Num() );
-					for( int32 i=0; i < DestChunkBoneMap.Num(); i++ )
-					{
-						MergeSectionInfo.BoneMapToMergedBoneMap.Add((FBoneIndexType)i);
-					}
+						MeshIdx,
+						TArrayView<const FBoneIndexType>(BoneMapStorage.GetData() + BoneMapOffset, DestChunkBoneMap.Num()),
+						SrcUVTransforms,
+						InstanceIndex);
 				}
 			}
 		}
@@ -517,7 +910,8 @@ void FCMSkeletalMeshMerge::CopyVertexFromSource(VertexDataType& DestVert, const
 	const uint32 ValidLoopCount = FMath::Min(VertexDataType::NumTexCoords, LODNumTexCoords);
 	for (uint32 UVIndex = 0; UVIndex < ValidLoopCount; ++UVIndex)
 	{
-		FVector2D UVs = SrcLODData.StaticVertexBuffers.StaticMeshVertexBuffer.GetVertexUV_Typed<VertexDataType::StaticMeshVertexUVType>(SourceVertIdx, UVIndex);
+		// the source precision can differ from the merged one
+		FVector2D UVs = SrcLODData.StaticVertexBuffers.StaticMeshVertexBuffer.GetVertexUV(SourceVertIdx, UVIndex);
 		if (UVIndex < (uint32)MergeSectionInfo.UVTransforms.Num())
 		{
 			FVector Transformed = MergeSectionInfo.UVTransforms[UVIndex].TransformPosition(FVector(UVs, 1.f));
@@ -533,44 +927,1402 @@ void FCMSkeletalMeshMerge::CopyVertexFromSource(VertexDataType& DestVert, const
 	}
 }
 
-/**
-* Creates a new LOD model and adds the new merged sections to it. Modifies the MergedMesh.
-* @param LODIdx - current LOD to process
-*/
-template<typename VertexDataType>
-void FCMSkeletalMeshMerge::GenerateLODModel( int32 LODIdx )
+bool FCMSkeletalMeshMerge::IsOuterLayerOf( const FCMSkelMeshPartHideMask& HideMask, int32 MeshIdx ) const
 {
-	// add the new LOD model entry
-	FSkeletalMeshRenderData* MergeResource = MergeMesh->GetResourceForRendering();
-	check(MergeResource);
+	return MeshIdx != HideMask.MeshIndex &&
+		SrcMeshList.IsValidIndex(MeshIdx) && SrcMeshList[MeshIdx] != nullptr &&
+		(HideMask.OuterLayerMeshIndices.Num() == 0 || HideMask.OuterLayerMeshIndices.Contains(MeshIdx));
+}
 
-	FSkeletalMeshLODRenderData& MergeLODData = *new FSkeletalMeshLODRenderData;
-	MergeResource->LODRenderData.Add(&MergeLODData);
+bool FCMSkeletalMeshMerge::IsHideMaskActive( const FCMSkelMeshPartHideMask& HideMask ) const
+{
+	if (!SrcMeshList.IsValidIndex(HideMask.MeshIndex) || SrcMeshList[HideMask.MeshIndex] == nullptr)
+	{
+		return false;
+	}
+
+	for (int32 MeshIdx = 0; MeshIdx < SrcMeshList.Num(); MeshIdx++)
+	{
+		if (IsOuterLayerOf(HideMask, MeshIdx))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+int32 FCMSkeletalMeshMerge::GetSourceLODIndex( int32 MeshIdx, int32 LODIdx ) const
+{
+	const FSkeletalMeshRenderData* SrcResource = SrcMeshList[MeshIdx]->GetResourceForRendering();
+	const int32 LastSrcLODIdx = SrcResource->LODRenderData.Num()-1;
+
+	// mapping tables are indexed by merged LOD, after the stripped top LODs
+	const int32 MergedLODIdx = LODIdx - StripTopLODs;
+	for (const FCMSkelMeshPartLODMapping& LODMapping : Options.LODMappings)
+	{
+		if (LODMapping.MeshIndex == MeshIdx && LODMapping.SourceLODs.Num() > 0)
+		{
+			const int32 SourceLODIdx = LODMapping.SourceLODs[FMath::Clamp(MergedLODIdx, 0, LODMapping.SourceLODs.Num()-1)];
+			return FMath::Clamp(SourceLODIdx, 0, LastSrcLODIdx);
+		}
+	}
+
+	return FMath::Min(LODIdx, LastSrcLODIdx);
+}
+
+const FSkeletalMeshLODRenderData& FCMSkeletalMeshMerge::GetSourceLODData( int32 MeshIdx, int32 LODIdx ) const
+{
+	return SrcMeshList[MeshIdx]->GetResourceForRendering()->LODRenderData[GetSourceLODIndex(MeshIdx, LODIdx)];
+}
+
+int32 FCMSkeletalMeshMerge::GetMaxBoneInfluences( int32 LODIdx ) const
+{
+	const TArray<int32>& MaxBoneInfluencesPerLOD = Options.MaxBoneInfluencesPerLOD;
+	if (MaxBoneInfluencesPerLOD.Num() == 0)
+	{
+		return 0;
+	}
+
+	const int32 MaxBoneInfluences = MaxBoneInfluencesPerLOD[FMath::Clamp(LODIdx - StripTopLODs, 0, MaxBoneInfluencesPerLOD.Num() - 1)];
+	return MaxBoneInfluences > 0 ? FMath::Min(MaxBoneInfluences, MAX_TOTAL_INFLUENCES) : 0;
+}
+
+ECMVertexFormatPolicy FCMSkeletalMeshMerge::GetVertexFormatPolicy( int32 LODIdx ) const
+{
+	const TArray<ECMVertexFormatPolicy>& VertexFormatPerLOD = Options.VertexFormatPerLOD;
+	return VertexFormatPerLOD.Num() > 0 ? VertexFormatPerLOD[FMath::Clamp(LODIdx - StripTopLODs, 0, VertexFormatPerLOD.Num() - 1)] : ECMVertexFormatPolicy::Source;
+}
+
+/**
+* @return largest difference between a full precision UV coordinate of the buffer and its half precision value
+*/
+static float GetHalfPrecisionUVError( const FStaticMeshVertexBuffer& VertexBuffer )
+{
+	float MaxError = 0.f;
+	for (uint32 VertIdx = 0; VertIdx < VertexBuffer.GetNumVertices(); VertIdx++)
+	{
+		for (uint32 UVIdx = 0; UVIdx < VertexBuffer.GetNumTexCoords(); UVIdx++)
+		{
+			const FVector2D UV = VertexBuffer.GetVertexUV_Typed<EStaticMeshVertexUVType::HighPrecision>(VertIdx, UVIdx);
+			const FVector2D HalfUV = FVector2D(FVector2DHalf(UV));
+			MaxError = FMath::Max3(MaxError, FMath::Abs(UV.X - HalfUV.X), FMath::Abs(UV.Y - HalfUV.Y));
+		}
+	}
+	return MaxError;
+}
+
+bool FCMSkeletalMeshMerge::UseFullPrecisionUVs( int32 LODIdx ) const
+{
+	if (!GVertexElementTypeSupport.IsSupported(VET_Half2))
+	{
+		return true;
+	}
+
+	const ECMVertexFormatPolicy Policy = GetVertexFormatPolicy(LODIdx);
+	if (Policy == ECMVertexFormatPolicy::Compact)
+	{
+		return false;
+	}
+
+	for (int32 MeshIdx = 0; MeshIdx < SrcMeshList.Num(); MeshIdx++)
+	{
+		if (SrcMeshList[MeshIdx] == nullptr)
+		{
+			continue;
+		}
+
+		const FStaticMeshVertexBuffer& VertexBuffer = GetSourceLODData(MeshIdx, LODIdx).StaticVertexBuffers.StaticMeshVertexBuffer;
+		if (VertexBuffer.GetUseFullPrecisionUVs() &&
+			(Policy == ECMVertexFormatPolicy::Source || GetHalfPrecisionUVError(VertexBuffer) > Options.VertexFormatUVTolerance))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+* @return false when the material is known not to read vertex colors. Only the editor keeps the expressions telling it
+*/
+static bool MaterialReadsVertexColors( UMaterialInterface* Material )
+{
+#if WITH_EDITOR
+	if (UMaterial* BaseMaterial = Material->GetMaterial())
+	{
+		// custom expressions can read the vertex color
+		TArray<UMaterialExpressionCustom*> CustomExpressions;
+		BaseMaterial->GetAllExpressionsInMaterialAndFunctionsOfType(CustomExpressions);
+		TArray<UMaterialExpressionVertexColor*> VertexColorExpressions;
+		BaseMaterial->GetAllExpressionsInMaterialAndFunctionsOfType(VertexColorExpressions);
+		return CustomExpressions.Num() > 0 || VertexColorExpressions.Num() > 0;
+	}
+#endif
+	return true;
+}
+
+/**
+* Finds the UV channels a material reads from its texture streaming data, texture coordinate expressions and the constant
+* coordinates of texture samples.
+* @return false when the UV channels can't be known, only the editor keeps the expressions telling them
+*/
+static bool GetMaterialUVChannelMask( UMaterialInterface* Material, uint8& OutUVChannelMask )
+{
+	OutUVChannelMask = 0;
+#if WITH_EDITOR
+	UMaterial* BaseMaterial = Material->GetMaterial();
+	if (BaseMaterial == nullptr)
+	{
+		return false;
+	}
+
+	// custom expressions can read any texture coordinate
+	TArray<UMaterialExpressionCustom*> CustomExpressions;
+	BaseMaterial->GetAllExpressionsInMaterialAndFunctionsOfType(CustomExpressions);
+	if (CustomExpressions.Num() > 0)
+	{
+		return false;
+	}
+
+	TArray<UMaterialExpressionTextureCoordinate*> TexCoordExpressions;
+	BaseMaterial->GetAllExpressionsInMaterialAndFunctionsOfType(TexCoordExpressions);
+	for (const UMaterialExpressionTextureCoordinate* Expression : TexCoordExpressions)
+	{
+		OutUVChannelMask |= 1 << FMath::Clamp(Expression->CoordinateIndex, 0, 7);
+	}
+
+	// samples without coordinates read their constant coordinate
+	TArray<UMaterialExpressionTextureSample*> SampleExpressions;
+	BaseMaterial->GetAllExpressionsInMaterialAndFunctionsOfType(SampleExpressions);
+	for (const UMaterialExpressionTextureSample* Expression : SampleExpressions)
+	{
+		if (!Expression->Coordinates.IsConnected())
+		{
+			OutUVChannelMask |= 1 << FMath::Min<int32>(Expression->ConstCoordinate, 7);
+		}
+	}
+
+	if (Material->HasTextureStreamingData())
+	{
+		for (const FMaterialTextureInfo& TextureInfo : Material->GetTextureStreamingData())
+		{
+			if (TextureInfo.IsValid())
+			{
+				OutUVChannelMask |= 1 << TextureInfo.UVChannelIndex;
+			}
+		}
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+FCMSkelMeshVertexStreams FCMSkeletalMeshMerge::GetUsedVertexStreams( const TScratchArray<FNewSectionInfo>& NewSectionArray ) const
+{
+	FCMSkelMeshVertexStreams Streams = Options.KeepVertexStreams;
+
+	// the instance index of merged material instances is read by every merged material
+	const uint8 InstanceIndexUVChannelMask = bMergeMaterialInstances ? 1 << Options.MaterialInstanceMerge.InstanceIndexUVChannel : 0;
+	Streams.UVChannelMask |= InstanceIndexUVChannelMask;
+	if (!Options.bPruneVertexStreamsByMaterial)
+	{
+		return Streams;
+	}
+
+	uint8 UsedUVChannelMask = InstanceIndexUVChannelMask;
+	bool bUsesVertexColors = false;
+	for (const FNewSectionInfo& NewSectionInfo : NewSectionArray)
+	{
+		UMaterialInterface* Material = NewSectionInfo.Material;
+		uint8 MaterialUVChannelMask = 0;
+		if (Material == nullptr || !GetMaterialUVChannelMask(Material, MaterialUVChannelMask))
+		{
+			// nothing tells which UV channels the material reads, keep them all
+			return Streams;
+		}
+
+		UsedUVChannelMask |= MaterialUVChannelMask;
+		bUsesVertexColors = bUsesVertexColors || MaterialReadsVertexColors(Material);
+	}
+
+	Streams.UVChannelMask &= UsedUVChannelMask;
+	Streams.bVertexColors &= bUsesVertexColors;
+	return Streams;
+}
+
+int32 FCMSkeletalMeshMerge::GetBakedMorphDeltas( int32 LODIdx, const FSourceVertexRemap& SourceVertexRemap, TScratchArray<FVector>& OutPositionDeltas, TScratchArray<FVector>& OutTangentZDeltas ) const
+{
+	if (Options.BakedMorphWeights.Num() == 0)
+	{
+		return 0;
+	}
+
+	int32 NumBakedMorphs = 0;
+	for (int32 MeshIdx = 0; MeshIdx < SrcMeshList.Num(); MeshIdx++)
+	{
+		const USkeletalMesh* SrcMesh = SrcMeshList[MeshIdx];
+		if (SrcMesh == nullptr)
+		{
+			continue;
+		}
+
+		const int32 SourceLODIdx = GetSourceLODIndex(MeshIdx, LODIdx);
+		const int32 MeshOffset = SourceVertexRemap.MeshOffsets[MeshIdx];
+		const uint32 NumMeshVertices = SourceVertexRemap.MeshOffsets[MeshIdx + 1] - MeshOffset;
+		for (const UMorphTarget* MorphTarget : SrcMesh->GetMorphTargets())
+		{
+			const float* Weight = Options.BakedMorphWeights.Find(MorphTarget->GetFName());
+			if (Weight == nullptr || *Weight == 0.f || !MorphTarget->MorphLODModels.IsValidIndex(SourceLODIdx))
+			{
+				continue;
+			}
+
+			if (NumBakedMorphs++ == 0)
+			{
+				OutPositionDeltas.SetNumZeroed(SourceVertexRemap.MergedVertexIndices.Num());
+				OutTangentZDeltas.SetNumZeroed(SourceVertexRemap.MergedVertexIndices.Num());
+			}
+
+			for (const FMorphTargetDelta& Delta : MorphTarget->MorphLODModels[SourceLODIdx].Vertices)
+			{
+				if (Delta.SourceIdx < NumMeshVertices)
+				{
+					OutPositionDeltas[MeshOffset + Delta.SourceIdx] += Delta.PositionDelta * *Weight;
+					OutTangentZDeltas[MeshOffset + Delta.SourceIdx] += Delta.TangentZDelta * *Weight;
+				}
+			}
+		}
+	}
+
+	return NumBakedMorphs;
+}
+
+void FCMSkeletalMeshMerge::CreateInstanceParameterTables()
+{
+	const FCMMaterialInstanceMergeOptions& MergeOptions = Options.MaterialInstanceMerge;
+	const int32 NumScalars = MergeOptions.ScalarParameters.Num();
+	const int32 TableWidth = FMath::Max(NumScalars + MergeOptions.VectorParameters.Num(), 1);
+
+	for (FSkeletalMaterial& SkeletalMaterial : MergeMesh->GetMaterials())
+	{
+		const TArray<UMaterialInterface*>* Instances = MergedMaterialInstances.Find(SkeletalMaterial.MaterialInterface);
+		if (Instances == nullptr)
+		{
+			continue;
+		}
+
+		// a lone instance keeps drawing with itself
+		if (Instances->Num() == 1)
+		{
+			SkeletalMaterial.MaterialInterface = (*Instances)[0];
+			continue;
+		}
+
+		const int32 TableHeight = Instances->Num();
+		TArray<FLinearColor> Table;
+		Table.SetNumZeroed(TableWidth * TableHeight);
+		for (int32 InstanceIdx = 0; InstanceIdx < TableHeight; InstanceIdx++)
+		{
+			const UMaterialInterface* Instance = (*Instances)[InstanceIdx];
+			FLinearColor* Row = Table.GetData() + InstanceIdx * TableWidth;
+			for (int32 ParameterIdx = 0; ParameterIdx < NumScalars; ParameterIdx++)
+			{
+				Instance->GetScalarParameterValue(FMaterialParameterInfo(MergeOptions.ScalarParameters[ParameterIdx]), Row[ParameterIdx].R);
+			}
+			for (int32 ParameterIdx = 0; ParameterIdx < MergeOptions.VectorParameters.Num(); ParameterIdx++)
+			{
+				Instance->GetVectorParameterValue(FMaterialParameterInfo(MergeOptions.VectorParameters[ParameterIdx]), Row[NumScalars + ParameterIdx]);
+			}
+		}
+
+		UTexture2D* TableTexture = UTexture2D::CreateTransient(TableWidth, TableHeight, PF_A32B32G32R32F);
+		if (TableTexture == nullptr)
+		{
+			continue;
+		}
+		TableTexture->SRGB = false;
+		TableTexture->Filter = TF_Nearest;
+		TableTexture->CompressionSettings = TC_HDR;
+		FTexture2DMipMap& Mip = TableTexture->PlatformData->Mips[0];
+		FMemory::Memcpy(Mip.BulkData.Lock(LOCK_READ_WRITE), Table.GetData(), Table.Num() * sizeof(FLinearColor));
+		Mip.BulkData.Unlock();
+		TableTexture->UpdateResource();
+
+		UMaterialInstanceDynamic* Material = UMaterialInstanceDynamic::Create(SkeletalMaterial.MaterialInterface, MergeMesh);
+		Material->SetTextureParameterValue(MergeOptions.ParameterTableParameter, TableTexture);
+		Material->SetVectorParameterValue(MergeOptions.ParameterTableSizeParameter, FLinearColor(TableWidth, TableHeight, 1.f / TableWidth, 1.f / TableHeight));
+		SkeletalMaterial.MaterialInterface = Material;
+
+		UE_LOG(LogCharacterMerger, Verbose, TEXT("Merged %d instances of %s into one section"), TableHeight, *SkeletalMaterial.MaterialInterface->GetName());
+	}
+}
+
+/**
+* Keeps the MaxInfluences largest weights of a vertex, moved to the first slots, and renormalizes them to the full quantized weight.
+* @return number of influences dropped
+*/
+static int32 LimitBoneInfluences( FSkinWeightInfo& Weights, int32 MaxInfluences )
+{
+	// works for both 8 and 16 bit weights
+	typedef typename TDecay<decltype(Weights.InfluenceWeights[0])>::Type FWeightType;
+	const uint32 FullWeight = TNumericLimits<FWeightType>::Max();
+
+	// non zero influences by decreasing weight
+	int32 Order[MAX_TOTAL_INFLUENCES];
+	int32 NumInfluences = 0;
+	for (int32 InfluenceIdx = 0; InfluenceIdx < MAX_TOTAL_INFLUENCES; InfluenceIdx++)
+	{
+		if (Weights.InfluenceWeights[InfluenceIdx] == 0)
+		{
+			continue;
+		}
+
+		int32 InsertIdx = NumInfluences++;
+		for (; InsertIdx > 0 && Weights.InfluenceWeights[Order[InsertIdx - 1]] < Weights.InfluenceWeights[InfluenceIdx]; InsertIdx--)
+		{
+			Order[InsertIdx] = Order[InsertIdx - 1];
+		}
+		Order[InsertIdx] = InfluenceIdx;
+	}
+
+	if (NumInfluences <= MaxInfluences)
+	{
+		return 0;
+	}
+
+	uint32 KeptWeight = 0;
+	for (int32 Idx = 0; Idx < MaxInfluences; Idx++)
+	{
+		KeptWeight += Weights.InfluenceWeights[Order[Idx]];
+	}
+
+	FSkinWeightInfo Limited;
+	FMemory::Memzero(Limited);
+	uint32 TotalWeight = 0;
+	for (int32 Idx = 0; Idx < MaxInfluences; Idx++)
+	{
+		Limited.InfluenceBones[Idx] = Weights.InfluenceBones[Order[Idx]];
+		Limited.InfluenceWeights[Idx] = (FWeightType)(Weights.InfluenceWeights[Order[Idx]] * FullWeight / KeptWeight);
+		TotalWeight += Limited.InfluenceWeights[Idx];
+	}
+
+	// rounding error goes to the largest influence so the weights sum to exactly one
+	Limited.InfluenceWeights[0] += (FWeightType)(FullWeight - TotalWeight);
+
+	Weights = Limited;
+	return NumInfluences - MaxInfluences;
+}
+
+/**
+* Moves the non zero influences of a vertex to its first slots, as variable influence skin weight buffers only store those
+* @return number of non zero influences
+*/
+static int32 CompactBoneInfluences( FSkinWeightInfo& Weights )
+{
+	int32 NumInfluences = 0;
+	for (int32 InfluenceIdx = 0; InfluenceIdx < MAX_TOTAL_INFLUENCES; InfluenceIdx++)
+	{
+		if (Weights.InfluenceWeights[InfluenceIdx] == 0)
+		{
+			continue;
+		}
+
+		if (NumInfluences != InfluenceIdx)
+		{
+			Weights.InfluenceBones[NumInfluences] = Weights.InfluenceBones[InfluenceIdx];
+			Weights.InfluenceWeights[NumInfluences] = Weights.InfluenceWeights[InfluenceIdx];
+			Weights.InfluenceBones[InfluenceIdx] = 0;
+			Weights.InfluenceWeights[InfluenceIdx] = 0;
+		}
+		NumInfluences++;
+	}
+	return NumInfluences;
+}
+
+int32 FCMSkeletalMeshMerge::GetSimplifySteps( int32 MeshIdx, int32 LODIdx ) const
+{
+	if (!Options.bSimplifyReusedLODs)
+	{
+		return 0;
+	}
+
+	// parts with a mapping table use the LODs they were given as is
+	for (const FCMSkelMeshPartLODMapping& LODMapping : Options.LODMappings)
+	{
+		if (LODMapping.MeshIndex == MeshIdx && LODMapping.SourceLODs.Num() > 0)
+		{
+			return 0;
+		}
+	}
+
+	return FMath::Max(LODIdx - (SrcMeshList[MeshIdx]->GetResourceForRendering()->LODRenderData.Num() - 1), 0);
+}
+
+/** largest screen size of a merged LOD relative to the previous one, keeps the screen sizes strictly decreasing */
+static const float MaxLODScreenSizeRatio = 0.99f;
+
+void FCMSkeletalMeshMerge::ComputeMergedLODScreenSize( FSkeletalMeshLODInfo& MergeLODInfo, int32 LODIdx ) const
+{
+	MergeLODInfo.ScreenSize = MergeLODInfo.LODHysteresis = MAX_FLT;
+
+	// keep track of the lowest LOD displayfactor and hysteresis of the parts switching LOD here.
+	// parts that keep the source LOD of the previous merged LOD say nothing about when this one should kick in
+	bool bAnyPartSwitches = false;
+	bool bAnyContribution = false;
+	for (int32 Pass = 0; Pass < 2 && !bAnyContribution; Pass++)
+	{
+		for (int32 MeshIdx = 0; MeshIdx < SrcMeshList.Num(); MeshIdx++)
+		{
+			if (SrcMeshList[MeshIdx] == nullptr)
+			{
+				continue;
+			}
+
+			const int32 SourceLODIdx = GetSourceLODIndex(MeshIdx, LODIdx);
+			const bool bSwitches = LODIdx == StripTopLODs || SourceLODIdx != GetSourceLODIndex(MeshIdx, LODIdx - 1);
+			if (Pass == 0 && !bSwitches)
+			{
+				continue;
+			}
+			bAnyPartSwitches |= bSwitches;
+			bAnyContribution = true;
+
+			const FSkeletalMeshLODInfo& SrcLODInfo = *(SrcMeshList[MeshIdx]->GetLODInfo(SourceLODIdx));
+			MergeLODInfo.ScreenSize.Default = FMath::Min<float>(MergeLODInfo.ScreenSize.Default, SrcLODInfo.ScreenSize.Default);
+#if WITH_EDITORONLY_DATA
+			for(const TPair<FName, float>& PerPlatform : SrcLODInfo.ScreenSize.PerPlatform)
+			{
+				float* Value = MergeLODInfo.ScreenSize.PerPlatform.Find(PerPlatform.Key);
+				if(Value)
+				{
+					*Value = FMath::Min<float>(PerPlatform.Value, *Value);	
+				}
+				else
+				{
+					MergeLODInfo.ScreenSize.PerPlatform.Add(PerPlatform.Key, PerPlatform.Value);
+				}
+			}
+#endif
+			MergeLODInfo.LODHysteresis = FMath::Min<float>(MergeLODInfo.LODHysteresis,SrcLODInfo.LODHysteresis);
+		}
+	}
+
+	// screen sizes must strictly decrease with the LOD index, a LOD with the screen size of the previous one is never selected
+	const int32 MergeLODIdx = MergeMesh->GetLODNum() - 1;
+	if (const FSkeletalMeshLODInfo* PrevLODInfo = MergeLODIdx > 0 ? MergeMesh->GetLODInfo(MergeLODIdx - 1) : nullptr)
+	{
+		// every part is simplified further, projected triangle density stays the same when the screen size scales with the square root of the triangle ratio
+		const bool bScaleFromPrevLOD = !bAnyPartSwitches && Options.bSimplifyReusedLODs;
+		const float SimplifyScreenSizeScale = FMath::Sqrt(FMath::Clamp(Options.SimplifyTriangleRatio, 0.f, 1.f));
+		auto ClampScreenSize = [&](float& ScreenSize, float PrevScreenSize)
+		{
+			if (bScaleFromPrevLOD)
+			{
+				ScreenSize = PrevScreenSize * SimplifyScreenSizeScale;
+			}
+			ScreenSize = FMath::Min<float>(ScreenSize, PrevScreenSize * MaxLODScreenSizeRatio);
+		};
+
+		ClampScreenSize(MergeLODInfo.ScreenSize.Default, PrevLODInfo->ScreenSize.Default);
+#if WITH_EDITORONLY_DATA
+		// platforms only the previous LOD overrides would use the default of this one
+		for (const TPair<FName, float>& PrevPerPlatform : PrevLODInfo->ScreenSize.PerPlatform)
+		{
+			if (!MergeLODInfo.ScreenSize.PerPlatform.Contains(PrevPerPlatform.Key))
+			{
+				MergeLODInfo.ScreenSize.PerPlatform.Add(PrevPerPlatform.Key, MergeLODInfo.ScreenSize.Default);
+			}
+		}
+		for (TPair<FName, float>& PerPlatform : MergeLODInfo.ScreenSize.PerPlatform)
+		{
+			const float* PrevScreenSize = PrevLODInfo->ScreenSize.PerPlatform.Find(PerPlatform.Key);
+			ClampScreenSize(PerPlatform.Value, PrevScreenSize ? *PrevScreenSize : PrevLODInfo->ScreenSize.Default);
+		}
+#endif
+
+		// the hysteresis band can't reach back past the previous LOD
+		MergeLODInfo.LODHysteresis = FMath::Clamp<float>(MergeLODInfo.LODHysteresis, 0.f, PrevLODInfo->ScreenSize.Default - MergeLODInfo.ScreenSize.Default);
+	}
+}
+
+/** @return the value of a color channel, 0 to 3 for R, G, B, A */
+static uint8 GetColorChannel( const FColor& Color, uint8 Channel )
+{
+	switch (Channel)
+	{
+	case 0:		return Color.R;
+	case 1:		return Color.G;
+	case 2:		return Color.B;
+	default:	return Color.A;
+	}
+}
+
+/**
+* Flags the vertices of a merge section hidden by a per-vertex hide mask
+* @param OutHiddenVertices - one entry per vertex of the source section
+*/
+void FCMSkeletalMeshMerge::GetHiddenVertices( const FCMSkelMeshPartHideMask& HideMask, const FMergeSectionInfo& MergeSectionInfo, int32 LODIdx, TScratchArray<bool>& OutHiddenVertices ) const
+{
+	const FSkelMeshRenderSection& SrcSection = *MergeSectionInfo.Section;
+	const FSkeletalMeshLODRenderData& SrcLODData = GetSourceLODData(MergeSectionInfo.MeshIdx, LODIdx);
+	const FStaticMeshVertexBuffers& VertexBuffers = SrcLODData.StaticVertexBuffers;
+	const int32 NumVertices = FMath::Min<int32>(SrcSection.NumVertices, (int32)VertexBuffers.PositionVertexBuffer.GetNumVertices() - (int32)SrcSection.BaseVertexIndex);
+
+	OutHiddenVertices.Reset();
+	OutHiddenVertices.Init(false, SrcSection.NumVertices);
+
+	switch (HideMask.Mode)
+	{
+	case ECMHideMaskMode::VertexColor:
+		{
+			const int32 NumColors = VertexBuffers.ColorVertexBuffer.GetNumVertices();
+			for (int32 VertIdx = 0; VertIdx < NumVertices; VertIdx++)
+			{
+				const int32 SrcVertIdx = SrcSection.BaseVertexIndex + VertIdx;
+				if (SrcVertIdx < NumColors)
+				{
+					OutHiddenVertices[VertIdx] = GetColorChannel(VertexBuffers.ColorVertexBuffer.VertexColor(SrcVertIdx), HideMask.Channel) > HideMask.Threshold;
+				}
+			}
+		}
+		break;
+
+	case ECMHideMaskMode::Texture:
+		{
+			// the mask is point sampled from the top mip, which has to be readable on the CPU
+			FTexturePlatformData* PlatformData = HideMask.Texture ? HideMask.Texture->PlatformData : nullptr;
+			const bool bReadable = PlatformData && PlatformData->Mips.Num() > 0 &&
+				(PlatformData->PixelFormat == PF_B8G8R8A8 || PlatformData->PixelFormat == PF_G8) &&
+				(uint32)HideMask.UVChannel < VertexBuffers.StaticMeshVertexBuffer.GetNumTexCoords();
+			if (!bReadable)
+			{
+				UE_LOG(LogCharacterMerger, Warning, TEXT("Hide mask texture %s of %s can't be sampled, it needs uncompressed B8G8R8A8 or G8 data and a valid UV channel"),
+					*GetNameSafe(HideMask.Texture), *MergeSectionInfo.SkelMesh->GetName());
+				break;
+			}
+
+			FTexture2DMipMap& Mip = PlatformData->Mips[0];
+			const uint8* MipData = (const uint8*)Mip.BulkData.LockReadOnly();
+			if (MipData)
+			{
+				const int32 BytesPerPixel = PlatformData->PixelFormat == PF_G8 ? 1 : 4;
+				// B8G8R8A8 stores the channels in reverse order
+				static const int32 BGRAChannelOffsets[4] = { 2, 1, 0, 3 };
+				const int32 ChannelOffset = BytesPerPixel == 1 ? 0 : BGRAChannelOffsets[FMath::Min<int32>(HideMask.Channel, 3)];
+
+				for (int32 VertIdx = 0; VertIdx < NumVertices; VertIdx++)
+				{
+					const FVector2D UV = VertexBuffers.StaticMeshVertexBuffer.GetVertexUV(SrcSection.BaseVertexIndex + VertIdx, HideMask.UVChannel);
+					const int32 X = FMath::Clamp(FMath::FloorToInt(FMath::Frac(UV.X) * Mip.SizeX), 0, Mip.SizeX - 1);
+					const int32 Y = FMath::Clamp(FMath::FloorToInt(FMath::Frac(UV.Y) * Mip.SizeY), 0, Mip.SizeY - 1);
+					OutHiddenVertices[VertIdx] = MipData[(Y * Mip.SizeX + X) * BytesPerPixel + ChannelOffset] > HideMask.Threshold;
+				}
+			}
+			Mip.BulkData.Unlock();
+		}
+		break;
+
+	case ECMHideMaskMode::Coverage:
+		{
+			// gather the outer layer triangles, every part shares the bind space of the merged skeleton
+			int32 NumOuterTriangles = 0;
+			for (int32 MeshIdx = 0; MeshIdx < SrcMeshList.Num(); MeshIdx++)
+			{
+				if (IsOuterLayerOf(HideMask, MeshIdx))
+				{
+					NumOuterTriangles += GetSourceLODData(MeshIdx, LODIdx).MultiSizeIndexContainer.GetIndexBuffer()->Num() / 3;
+				}
+			}
+
+			CMMeshOptimization::FTriangleCoverageGrid CoverageGrid(HideMask.CoverageDistance, NumOuterTriangles);
+			for (int32 MeshIdx = 0; MeshIdx < SrcMeshList.Num(); MeshIdx++)
+			{
+				if (IsOuterLayerOf(HideMask, MeshIdx))
+				{
+					const FSkeletalMeshLODRenderData& OuterLODData = GetSourceLODData(MeshIdx, LODIdx);
+					const FPositionVertexBuffer& OuterPositions = OuterLODData.StaticVertexBuffers.PositionVertexBuffer;
+					const FRawStaticIndexBuffer16or32Interface* OuterIndices = OuterLODData.MultiSizeIndexContainer.GetIndexBuffer();
+					for (int32 Index = 0; Index + 2 < OuterIndices->Num(); Index += 3)
+					{
+						CoverageGrid.AddTriangle(
+							OuterPositions.VertexPosition(OuterIndices->Get(Index)),
+							OuterPositions.VertexPosition(OuterIndices->Get(Index + 1)),
+							OuterPositions.VertexPosition(OuterIndices->Get(Index + 2)));
+					}
+				}
+			}
+
+			if (CoverageGrid.IsEmpty())
+			{
+				break;
+			}
+
+			for (int32 VertIdx = 0; VertIdx < NumVertices; VertIdx++)
+			{
+				const int32 SrcVertIdx = SrcSection.BaseVertexIndex + VertIdx;
+				const FVector Position = VertexBuffers.PositionVertexBuffer.VertexPosition(SrcVertIdx);
+				const FVector Normal = FVector(VertexBuffers.StaticMeshVertexBuffer.VertexTangentZ(SrcVertIdx)).GetSafeNormal();
+				OutHiddenVertices[VertIdx] = !Normal.IsZero() && CoverageGrid.RaycastAny(Position, Normal, HideMask.CoverageDistance);
+			}
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+/**
+* Flags the triangles of a merge section that Options.HideMasks hide under outer layers
+* @param MergeSectionInfo - source section to test
+* @param LODIdx - current LOD to process
+* @param OutHiddenTriangles - one entry per triangle of the source section, empty when no mask applies
+* @return number of hidden triangles
+*/
+int32 FCMSkeletalMeshMerge::GetHiddenTriangles( const FMergeSectionInfo& MergeSectionInfo, int32 LODIdx, TScratchArray<bool>& OutHiddenTriangles )
+{
+	OutHiddenTriangles.Reset();
+	if (Options.HideMasks.Num() == 0)
+	{
+		return 0;
+	}
+
+	CM_SCOPE_MERGE_PHASE(STAT_CharacterMerger_HideTriangles, HideTriangles);
+
+	const FSkelMeshRenderSection& SrcSection = *MergeSectionInfo.Section;
+	const int32 SourceLODIdx = GetSourceLODIndex(MergeSectionInfo.MeshIdx, LODIdx);
+	const FRawStaticIndexBuffer16or32Interface* SrcIndices = GetSourceLODData(MergeSectionInfo.MeshIdx, LODIdx).MultiSizeIndexContainer.GetIndexBuffer();
+	const int32 NumTriangles = FMath::Min<int32>(SrcSection.NumTriangles, (SrcIndices->Num() - (int32)SrcSection.BaseIndex) / 3);
+
+	TScratchArray<bool> HiddenVertices;
+	for (const FCMSkelMeshPartHideMask& HideMask : Options.HideMasks)
+	{
+		if (HideMask.MeshIndex != MergeSectionInfo.MeshIdx || !IsHideMaskActive(HideMask))
+		{
+			continue;
+		}
+
+		if (OutHiddenTriangles.Num() == 0)
+		{
+			OutHiddenTriangles.Init(false, SrcSection.NumTriangles);
+		}
+
+		if (HideMask.Mode == ECMHideMaskMode::TriangleList)
+		{
+			if (HideMask.HiddenTrianglesPerLOD.IsValidIndex(SourceLODIdx))
+			{
+				const int32 BaseTriangle = SrcSection.BaseIndex / 3;
+				for (int32 TriangleIdx : HideMask.HiddenTrianglesPerLOD[SourceLODIdx])
+				{
+					if (TriangleIdx >= BaseTriangle && TriangleIdx - BaseTriangle < NumTriangles)
+					{
+						OutHiddenTriangles[TriangleIdx - BaseTriangle] = true;
+					}
+				}
+			}
+			continue;
+		}
+
+		// a triangle is only covered when all its vertices are
+		GetHiddenVertices(HideMask, MergeSectionInfo, LODIdx, HiddenVertices);
+		for (int32 TriangleIdx = 0; TriangleIdx < NumTriangles; TriangleIdx++)
+		{
+			bool bHidden = true;
+			for (int32 Corner = 0; Corner < 3 && bHidden; Corner++)
+			{
+				const int32 VertIdx = (int32)SrcIndices->Get(SrcSection.BaseIndex + TriangleIdx * 3 + Corner) - (int32)SrcSection.BaseVertexIndex;
+				bHidden = HiddenVertices.IsValidIndex(VertIdx) && HiddenVertices[VertIdx];
+			}
+			OutHiddenTriangles[TriangleIdx] |= bHidden;
+		}
+	}
+
+	int32 NumHiddenTriangles = 0;
+	for (bool bHidden : OutHiddenTriangles)
+	{
+		NumHiddenTriangles += bHidden ? 1 : 0;
+	}
+	return NumHiddenTriangles;
+}
+
+/**
+* Builds the duplicated vertices buffer of a new section from all its merge sections in one pass.
+* Must be called once Section.NumVertices is final.
+* @param Section - new render section to fill
+* @param NewSectionInfo - merge sections making up the new section, in vertex order
+* @param SourceVertexRemap - merged vertex index of every source vertex
+*/
+void FCMSkeletalMeshMerge::GenerateDuplicatedVertices( FSkelMeshRenderSection& Section, const FNewSectionInfo& NewSectionInfo, const FSourceVertexRemap& SourceVertexRemap )
+{
+	// exact sizes of the merged buffers
+	bool bHasOverlappingVertices = false;
+	int32 NumDupVerts = 0;
+	for (const FMergeSectionInfo& MergeSectionInfo : NewSectionInfo.MergeSections)
+	{
+		const FDuplicatedVerticesBuffer& SrcDupVerts = MergeSectionInfo.Section->DuplicatedVerticesBuffer;
+		if (SrcDupVerts.bHasOverlappingVertices)
+		{
+			bHasOverlappingVertices = true;
+			NumDupVerts += SrcDupVerts.DupVertData.Num();
+		}
+	}
+
+	FDuplicatedVerticesBuffer& DupVerts = Section.DuplicatedVerticesBuffer;
+	DupVerts.bHasOverlappingVertices = bHasOverlappingVertices;
+	DupVerts.DupVertData.ResizeBuffer(FMath::Max(NumDupVerts, 1));
+	DupVerts.DupVertIndexData.ResizeBuffer(Section.NumVertices);
+
+	uint32* VertData = (uint32*)DupVerts.DupVertData.GetDataPointer();
+	FIndexLengthPair* IndexData = (FIndexLengthPair*)DupVerts.DupVertIndexData.GetDataPointer();
+
+	FMemory::Memzero(IndexData, Section.NumVertices * sizeof(FIndexLengthPair));
+	if (!bHasOverlappingVertices)
+	{
+		FMemory::Memzero(VertData, sizeof(uint32));
+		return;
+	}
+
+	// a merged vertex takes the duplicates of the first source vertex that landed on it,
+	// welded vertices point back at a vertex kept from an earlier merge section
+	TScratchArray<bool> HasIndexData;
+	HasIndexData.Init(false, Section.NumVertices);
+
+	int32 DupVertOffset = 0;
+	for (const FMergeSectionInfo& MergeSectionInfo : NewSectionInfo.MergeSections)
+	{
+		const FSkelMeshRenderSection& SrcSection = *MergeSectionInfo.Section;
+		// GetDataPointer is not const, the source buffers are only read
+		FDuplicatedVerticesBuffer& SrcDupVerts = const_cast<FDuplicatedVerticesBuffer&>(SrcSection.DuplicatedVerticesBuffer);
+		if (!SrcDupVerts.bHasOverlappingVertices)
+		{
+			continue;
+		}
+
+		const TArrayView<const int32> MeshRemap = SourceVertexRemap.GetMeshRemap(MergeSectionInfo.MeshIdx);
+
+		const uint32* SrcVertData = (const uint32*)SrcDupVerts.DupVertData.GetDataPointer();
+		const int32 NumSrcDupVerts = SrcDupVerts.DupVertData.Num();
+		for (int32 i = 0; i < NumSrcDupVerts; ++i)
+		{
+			const int32 MergedVertIdx = MeshRemap.IsValidIndex(SrcVertData[i]) ? MeshRemap[SrcVertData[i]] : INDEX_NONE;
+			VertData[DupVertOffset + i] = MergedVertIdx != INDEX_NONE ? MergedVertIdx : Section.BaseVertexIndex;
+		}
+
+		const FIndexLengthPair* SrcIndexData = (const FIndexLengthPair*)SrcDupVerts.DupVertIndexData.GetDataPointer();
+		const uint32 NumSrcIndexData = FMath::Min<uint32>(SrcSection.NumVertices, SrcDupVerts.DupVertIndexData.Num());
+		for (uint32 i = 0; i < NumSrcIndexData; ++i)
+		{
+			const int32 SrcVertIdx = SrcSection.BaseVertexIndex + i;
+			const int32 MergedVertIdx = MeshRemap.IsValidIndex(SrcVertIdx) ? MeshRemap[SrcVertIdx] : INDEX_NONE;
+			const int32 SectionVertIdx = MergedVertIdx - (int32)Section.BaseVertexIndex;
+			if (MergedVertIdx != INDEX_NONE && HasIndexData.IsValidIndex(SectionVertIdx) && !HasIndexData[SectionVertIdx])
+			{
+				HasIndexData[SectionVertIdx] = true;
+				IndexData[SectionVertIdx].Index = SrcIndexData[i].Index + DupVertOffset;
+				IndexData[SectionVertIdx].Length = SrcIndexData[i].Length;
+			}
+		}
+
+		DupVertOffset += NumSrcDupVerts;
+	}
+}
+
+/**
+* Collapses the vertices of the last merged section that match in every attribute, within Options tolerances.
+* The section must be at the end of the merged buffers, which are compacted in place.
+* @param Section - section to weld, its vertex and triangle counts are updated
+* @param NewSectionInfo - merge sections making up the section
+* @param SourceVertexRemap - updated to point at the welded vertices
+* @return number of vertices removed
+*/
+template<typename VertexDataType>
+int32 FCMSkeletalMeshMerge::WeldSectionVertices( FSkelMeshRenderSection& Section, const FNewSectionInfo& NewSectionInfo, TScratchArray<VertexDataType>& VertexBuffer,
+	TArray<FSkinWeightInfo>& SkinWeightBuffer, TScratchArray<FColor>& ColorBuffer, TArray<uint32>& IndexBuffer, FSourceVertexRemap& SourceVertexRemap )
+{
+	CM_SCOPE_MERGE_PHASE(STAT_CharacterMerger_WeldVertices, WeldVertices);
+
+	const int32 BaseVertexIndex = Section.BaseVertexIndex;
+	const int32 NumVertices = VertexBuffer.Num() - BaseVertexIndex;
+	check(SkinWeightBuffer.Num() == VertexBuffer.Num());
+	const bool bHasColors = ColorBuffer.Num() == VertexBuffer.Num();
+
+	const float TangentThreshold = 1.f - Options.WeldTangentTolerance;
+	const float UVTolerance = Options.WeldUVTolerance;
+	const int32 ColorTolerance = Options.WeldColorTolerance;
+	const int32 SkinWeightTolerance = Options.WeldSkinWeightTolerance;
+
+	auto GetPosition = [&VertexBuffer, BaseVertexIndex](int32 VertIdx)
+	{
+		return VertexBuffer[BaseVertexIndex + VertIdx].Position;
+	};
+
+	auto AreEquivalent = [&](int32 KeptIdx, int32 VertIdx)
+	{
+		const VertexDataType& KeptVert = VertexBuffer[BaseVertexIndex + KeptIdx];
+		const VertexDataType& Vert = VertexBuffer[BaseVertexIndex + VertIdx];
+
+		// tangent frame, including the binormal sign
+		const FVector4 KeptTangentZ = KeptVert.TangentZ.ToFVector4();
+		const FVector4 TangentZ = Vert.TangentZ.ToFVector4();
+		if ((KeptTangentZ.W < 0.f) != (TangentZ.W < 0.f) ||
+			FVector::DotProduct(FVector(KeptTangentZ), FVector(TangentZ)) < TangentThreshold ||
+			FVector::DotProduct(KeptVert.TangentX.ToFVector(), Vert.TangentX.ToFVector()) < TangentThreshold)
+		{
+			return false;
+		}
+
+		for (int32 UVIdx = 0; UVIdx < UE_ARRAY_COUNT(Vert.UVs); UVIdx++)
+		{
+			const FVector2D KeptUV(KeptVert.UVs[UVIdx]);
+			const FVector2D UV(Vert.UVs[UVIdx]);
+			if (FMath::Abs(KeptUV.X - UV.X) > UVTolerance || FMath::Abs(KeptUV.Y - UV.Y) > UVTolerance)
+			{
+				return false;
+			}
+		}
+
+		if (bHasColors)
+		{
+			const FColor& KeptColor = ColorBuffer[BaseVertexIndex + KeptIdx];
+			const FColor& Color = ColorBuffer[BaseVertexIndex + VertIdx];
+			if (FMath::Abs(KeptColor.R - Color.R) > ColorTolerance || FMath::Abs(KeptColor.G - Color.G) > ColorTolerance ||
+				FMath::Abs(KeptColor.B - Color.B) > ColorTolerance || FMath::Abs(KeptColor.A - Color.A) > ColorTolerance)
+			{
+				return false;
+			}
+		}
+
+		// every influence of one vertex needs a matching bone and weight in the other, both ways
+		const FSkinWeightInfo& KeptWeight = SkinWeightBuffer[BaseVertexIndex + KeptIdx];
+		const FSkinWeightInfo& Weight = SkinWeightBuffer[BaseVertexIndex + VertIdx];
+		auto HasInfluences = [SkinWeightTolerance](const FSkinWeightInfo& A, const FSkinWeightInfo& B)
+		{
+			for (int32 InfluenceIdx = 0; InfluenceIdx < MAX_TOTAL_INFLUENCES; InfluenceIdx++)
+			{
+				if (A.InfluenceWeights[InfluenceIdx] == 0)
+				{
+					continue;
+				}
+
+				int32 OtherWeight = 0;
+				for (int32 OtherIdx = 0; OtherIdx < MAX_TOTAL_INFLUENCES; OtherIdx++)
+				{
+					if (B.InfluenceWeights[OtherIdx] > 0 && B.InfluenceBones[OtherIdx] == A.InfluenceBones[InfluenceIdx])
+					{
+						OtherWeight = B.InfluenceWeights[OtherIdx];
+						break;
+					}
+				}
+
+				if (FMath::Abs(OtherWeight - (int32)A.InfluenceWeights[InfluenceIdx]) > SkinWeightTolerance)
+				{
+					return false;
+				}
+			}
+			return true;
+		};
+		return HasInfluences(KeptWeight, Weight) && HasInfluences(Weight, KeptWeight);
+	};
+
+	TScratchArray<int32> WeldRemap;
+	const int32 NumWelded = CMMeshOptimization::FindWeldedVertices(NumVertices, GetPosition, Options.WeldPositionTolerance, AreEquivalent, WeldRemap);
+	if (NumWelded == 0)
+	{
+		return 0;
+	}
+
+	// compact the kept vertices, welded ones take the compacted index of the vertex they collapsed into
+	int32 NumKept = 0;
+	for (int32 VertIdx = 0; VertIdx < NumVertices; VertIdx++)
+	{
+		if (WeldRemap[VertIdx] == VertIdx)
+		{
+			if (NumKept != VertIdx)
+			{
+				VertexBuffer[BaseVertexIndex + NumKept] = VertexBuffer[BaseVertexIndex + VertIdx];
+				SkinWeightBuffer[BaseVertexIndex + NumKept] = SkinWeightBuffer[BaseVertexIndex + VertIdx];
+				if (bHasColors)
+				{
+					ColorBuffer[BaseVertexIndex + NumKept] = ColorBuffer[BaseVertexIndex + VertIdx];
+				}
+			}
+			WeldRemap[VertIdx] = NumKept++;
+		}
+		else
+		{
+			// always points at an earlier vertex, already compacted
+			WeldRemap[VertIdx] = WeldRemap[WeldRemap[VertIdx]];
+		}
+	}
+
+	VertexBuffer.SetNum(BaseVertexIndex + NumKept, false);
+	SkinWeightBuffer.SetNum(BaseVertexIndex + NumKept, false);
+	if (bHasColors)
+	{
+		ColorBuffer.SetNum(BaseVertexIndex + NumKept, false);
+	}
+	Section.NumVertices = NumKept;
+
+	// remap the section indices and drop the triangles that welding made degenerate
+	int32 NumIndices = Section.BaseIndex;
+	for (int32 Index = Section.BaseIndex; Index + 2 < IndexBuffer.Num(); Index += 3)
+	{
+		const uint32 Index0 = BaseVertexIndex + WeldRemap[IndexBuffer[Index + 0] - BaseVertexIndex];
+		const uint32 Index1 = BaseVertexIndex + WeldRemap[IndexBuffer[Index + 1] - BaseVertexIndex];
+		const uint32 Index2 = BaseVertexIndex + WeldRemap[IndexBuffer[Index + 2] - BaseVertexIndex];
+		if (Index0 != Index1 && Index1 != Index2 && Index0 != Index2)
+		{
+			IndexBuffer[NumIndices++] = Index0;
+			IndexBuffer[NumIndices++] = Index1;
+			IndexBuffer[NumIndices++] = Index2;
+		}
+	}
+	IndexBuffer.SetNum(NumIndices, false);
+	Section.NumTriangles = (NumIndices - Section.BaseIndex) / 3;
+
+	// source vertices follow the vertex they were welded into
+	for (const FMergeSectionInfo& MergeSectionInfo : NewSectionInfo.MergeSections)
+	{
+		const int32 SrcBaseVertexIndex = MergeSectionInfo.Section->BaseVertexIndex;
+		const int32 NumSrcVertices = FMath::Min<int32>(MergeSectionInfo.Section->NumVertices, SourceVertexRemap.GetMeshRemap(MergeSectionInfo.MeshIdx).Num() - SrcBaseVertexIndex);
+		for (int32 VertIdx = 0; VertIdx < NumSrcVertices; VertIdx++)
+		{
+			int32& MergedVertIdx = SourceVertexRemap.Get(MergeSectionInfo.MeshIdx, SrcBaseVertexIndex + VertIdx);
+			if (MergedVertIdx != INDEX_NONE)
+			{
+				MergedVertIdx = BaseVertexIndex + WeldRemap[MergedVertIdx - BaseVertexIndex];
+			}
+		}
+	}
+
+	return NumWelded;
+}
+
+/**
+* Simplifies the merged sections holding parts past their last LOD in parallel, then compacts the merged buffers.
+* Vertices of the parts that keep their own LOD are never moved.
+* @param NewSectionArray - merge sections making up every merged section
+* @param Sections - merged sections, their ranges are updated
+* @param LODIdx - current LOD to process
+* @param SourceVertexRemap - updated to point at the kept vertices
+* @return number of triangles removed
+*/
+template<typename VertexDataType>
+int32 FCMSkeletalMeshMerge::SimplifySections( TArrayView<const FNewSectionInfo> NewSectionArray, TArray<FSkelMeshRenderSection>& Sections, int32 LODIdx, TScratchArray<VertexDataType>& VertexBuffer,
+	TArray<FSkinWeightInfo>& SkinWeightBuffer, TScratchArray<FColor>& ColorBuffer, TArray<uint32>& IndexBuffer, FSourceVertexRemap& SourceVertexRemap )
+{
+	CM_SCOPE_MERGE_PHASE(STAT_CharacterMerger_Simplify, Simplify);
+
+	const int32 NumSections = Sections.Num();
+	check(NewSectionArray.Num() == NumSections);
+	const bool bHasColors = ColorBuffer.Num() == VertexBuffer.Num();
+
+	// sections are contiguous in the merged buffers, so each one ends where the next one starts
+	auto GetSectionEndVertex = [&](int32 SectionIdx)
+	{
+		return SectionIdx + 1 < NumSections ? (int32)Sections[SectionIdx + 1].BaseVertexIndex : VertexBuffer.Num();
+	};
+	auto GetSectionEndIndex = [&](int32 SectionIdx)
+	{
+		return SectionIdx + 1 < NumSections ? (int32)Sections[SectionIdx + 1].BaseIndex : IndexBuffer.Num();
+	};
+
+	// triangle budget of every section, scaled by the triangles of each part past its last LOD
+	TScratchArray<int32> TargetNumTriangles;
+	TargetNumTriangles.SetNumUninitialized(NumSections);
+	TScratchArray<bool> LockedVertices;
+	LockedVertices.Init(false, VertexBuffer.Num());
+	bool bAnySectionSimplified = false;
+	for (int32 SectionIdx = 0; SectionIdx < NumSections; SectionIdx++)
+	{
+		double NumSrcTriangles = 0.0;
+		double NumKeptSrcTriangles = 0.0;
+		for (const FMergeSectionInfo& MergeSectionInfo : NewSectionArray[SectionIdx].MergeSections)
+		{
+			const int32 SimplifySteps = GetSimplifySteps(MergeSectionInfo.MeshIdx, LODIdx);
+			NumSrcTriangles += MergeSectionInfo.Section->NumTriangles;
+			NumKeptSrcTriangles += MergeSectionInfo.Section->NumTriangles * FMath::Pow(FMath::Clamp(Options.SimplifyTriangleRatio, 0.f, 1.f), (float)SimplifySteps);
+
+			if (SimplifySteps == 0)
+			{
+				// parts merged with their own LOD keep every vertex
+				const int32 SrcBaseVertexIndex = MergeSectionInfo.Section->BaseVertexIndex;
+				const int32 NumSrcVertices = FMath::Min<int32>(MergeSectionInfo.Section->NumVertices, SourceVertexRemap.GetMeshRemap(MergeSectionInfo.MeshIdx).Num() - SrcBaseVertexIndex);
+				for (int32 VertIdx = 0; VertIdx < NumSrcVertices; VertIdx++)
+				{
+					const int32 MergedVertIdx = SourceVertexRemap.Get(MergeSectionInfo.MeshIdx, SrcBaseVertexIndex + VertIdx);
+					if (MergedVertIdx != INDEX_NONE)
+					{
+						LockedVertices[MergedVertIdx] = true;
+					}
+				}
+			}
+		}
+
+		const int32 NumTriangles = (GetSectionEndIndex(SectionIdx) - (int32)Sections[SectionIdx].BaseIndex) / 3;
+		TargetNumTriangles[SectionIdx] = NumSrcTriangles > 0.0 ? FMath::CeilToInt(NumTriangles * NumKeptSrcTriangles / NumSrcTriangles) : NumTriangles;
+		bAnySectionSimplified |= TargetNumTriangles[SectionIdx] < NumTriangles;
+	}
+
+	if (!bAnySectionSimplified)
+	{
+		return 0;
+	}
+
+	// vertex every vertex collapsed into, section local, and the number of indices kept at the start of each section
+	TScratchArray<int32> CollapseRemap;
+	CollapseRemap.SetNumUninitialized(VertexBuffer.Num());
+	TScratchArray<int32> NumKeptIndices;
+	NumKeptIndices.SetNumUninitialized(NumSections);
+
+	// sections only touch their own ranges, so they are simplified in parallel
+	ParallelFor(NumSections, [&](int32 SectionIdx)
+	{
+		const FSkelMeshRenderSection& Section = Sections[SectionIdx];
+		const int32 BaseVertexIndex = Section.BaseVertexIndex;
+		const int32 NumVertices = GetSectionEndVertex(SectionIdx) - BaseVertexIndex;
+		TArrayView<int32> SectionRemap(CollapseRemap.GetData() + BaseVertexIndex, NumVertices);
+		TArrayView<uint32> Indices(IndexBuffer.GetData() + Section.BaseIndex, GetSectionEndIndex(SectionIdx) - Section.BaseIndex);
+
+		if (TargetNumTriangles[SectionIdx] >= Indices.Num() / 3)
+		{
+			for (int32 VertIdx = 0; VertIdx < NumVertices; VertIdx++)
+			{
+				SectionRemap[VertIdx] = VertIdx;
+			}
+			NumKeptIndices[SectionIdx] = Indices.Num();
+			return;
+		}
+
+		// temporaries come from the scratch arena of the worker thread
+		FMemMark Mark(FMemStack::Get());
+
+		TScratchArray<FVector> Positions;
+		Positions.SetNumUninitialized(NumVertices);
+		for (int32 VertIdx = 0; VertIdx < NumVertices; VertIdx++)
+		{
+			Positions[VertIdx] = VertexBuffer[BaseVertexIndex + VertIdx].Position;
+		}
+
+		for (uint32& Index : Indices)
+		{
+			Index -= BaseVertexIndex;
+		}
+
+		// a vertex only moves into a vertex influenced by all of its bones, keeping skin weight boundaries in place
+		auto CanCollapse = [&](int32 From, int32 To)
+		{
+			if (LockedVertices[BaseVertexIndex + From])
+			{
+				return false;
+			}
+
+			const FSkinWeightInfo& FromWeight = SkinWeightBuffer[BaseVertexIndex + From];
+			const FSkinWeightInfo& ToWeight = SkinWeightBuffer[BaseVertexIndex + To];
+			for (int32 InfluenceIdx = 0; InfluenceIdx < MAX_TOTAL_INFLUENCES; InfluenceIdx++)
+			{
+				if (FromWeight.InfluenceWeights[InfluenceIdx] == 0)
+				{
+					continue;
+				}
+
+				bool bHasBone = false;
+				for (int32 OtherIdx = 0; OtherIdx < MAX_TOTAL_INFLUENCES && !bHasBone; OtherIdx++)
+				{
+					bHasBone = ToWeight.InfluenceWeights[OtherIdx] > 0 && ToWeight.InfluenceBones[OtherIdx] == FromWeight.InfluenceBones[InfluenceIdx];
+				}
+				if (!bHasBone)
+				{
+					return false;
+				}
+			}
+			return true;
+		};
+
+		NumKeptIndices[SectionIdx] = CMMeshOptimization::SimplifyTriangles(Indices, Positions, TargetNumTriangles[SectionIdx], Options.SimplifyMaxError, CanCollapse, SectionRemap);
+
+		for (int32 IndexIdx = 0; IndexIdx < NumKeptIndices[SectionIdx]; IndexIdx++)
+		{
+			Indices[IndexIdx] += BaseVertexIndex;
+		}
+	});
+
+	// compact the kept vertices and indices of every section, collapsed vertices take the index of the vertex they collapsed into
+	TScratchArray<int32> OldToNew;
+	OldToNew.SetNumUninitialized(VertexBuffer.Num());
+	TScratchArray<bool> CollapsedVertices;
+	CollapsedVertices.SetNumUninitialized(VertexBuffer.Num());
+	int32 NumVertices = 0;
+	int32 NumIndices = 0;
+	int32 NumRemovedTriangles = 0;
+	for (int32 SectionIdx = 0; SectionIdx < NumSections; SectionIdx++)
+	{
+		FSkelMeshRenderSection& Section = Sections[SectionIdx];
+		const int32 OldBaseVertexIndex = Section.BaseVertexIndex;
+		const int32 OldNumVertices = GetSectionEndVertex(SectionIdx) - OldBaseVertexIndex;
+		const int32 OldBaseIndex = Section.BaseIndex;
+		const int32 OldNumIndices = GetSectionEndIndex(SectionIdx) - OldBaseIndex;
+
+		Section.BaseVertexIndex = NumVertices;
+		for (int32 VertIdx = 0; VertIdx < OldNumVertices; VertIdx++)
+		{
+			const int32 OldVertIdx = OldBaseVertexIndex + VertIdx;
+			CollapsedVertices[OldVertIdx] = CollapseRemap[OldVertIdx] != VertIdx;
+			if (!CollapsedVertices[OldVertIdx])
+			{
+				if (NumVertices != OldVertIdx)
+				{
+					VertexBuffer[NumVertices] = VertexBuffer[OldVertIdx];
+					SkinWeightBuffer[NumVertices] = SkinWeightBuffer[OldVertIdx];
+					if (bHasColors)
+					{
+						ColorBuffer[NumVertices] = ColorBuffer[OldVertIdx];
+					}
+				}
+				OldToNew[OldVertIdx] = NumVertices++;
+			}
+		}
+		for (int32 VertIdx = 0; VertIdx < OldNumVertices; VertIdx++)
+		{
+			const int32 OldVertIdx = OldBaseVertexIndex + VertIdx;
+			if (CollapsedVertices[OldVertIdx])
+			{
+				OldToNew[OldVertIdx] = OldToNew[OldBaseVertexIndex + CollapseRemap[OldVertIdx]];
+			}
+		}
+		Section.NumVertices = NumVertices - Section.BaseVertexIndex;
+
+		Section.BaseIndex = NumIndices;
+		for (int32 IndexIdx = 0; IndexIdx < NumKeptIndices[SectionIdx]; IndexIdx++)
+		{
+			IndexBuffer[NumIndices++] = OldToNew[IndexBuffer[OldBaseIndex + IndexIdx]];
+		}
+		Section.NumTriangles = NumKeptIndices[SectionIdx] / 3;
+		NumRemovedTriangles += (OldNumIndices - NumKeptIndices[SectionIdx]) / 3;
+	}
+
+	VertexBuffer.SetNum(NumVertices, false);
+	SkinWeightBuffer.SetNum(NumVertices, false);
+	if (bHasColors)
+	{
+		ColorBuffer.SetNum(NumVertices, false);
+	}
+	IndexBuffer.SetNum(NumIndices, false);
+
+	// source vertices follow the vertex they collapsed into and give up its ownership
+	for (int32 SrcVertKey = 0; SrcVertKey < SourceVertexRemap.MergedVertexIndices.Num(); SrcVertKey++)
+	{
+		int32& MergedVertIdx = SourceVertexRemap.MergedVertexIndices[SrcVertKey];
+		if (MergedVertIdx != INDEX_NONE)
+		{
+			if (CollapsedVertices[MergedVertIdx])
+			{
+				SourceVertexRemap.OwnsMergedVertex[SrcVertKey] = false;
+			}
+			MergedVertIdx = OldToNew[MergedVertIdx];
+		}
+	}
+
+	return NumRemovedTriangles;
+}
+
+/**
+* Reorders the triangles of a merged section for vertex cache locality, then its vertices by first use.
+* The section ranges of the merged buffers are permuted in place.
+* @param Section - section to optimize
+* @param NewSectionInfo - merge sections making up the section
+* @param SourceVertexRemap - updated to point at the reordered vertices
+*/
+template<typename VertexDataType>
+void FCMSkeletalMeshMerge::OptimizeSectionVertexCache( FSkelMeshRenderSection& Section, const FNewSectionInfo& NewSectionInfo, TScratchArray<VertexDataType>& VertexBuffer,
+	TArray<FSkinWeightInfo>& SkinWeightBuffer, TScratchArray<FColor>& ColorBuffer, TArray<uint32>& IndexBuffer, FSourceVertexRemap& SourceVertexRemap )
+{
+	CM_SCOPE_MERGE_PHASE(STAT_CharacterMerger_OptimizeVertexCache, OptimizeVertexCache);
+
+	const int32 BaseVertexIndex = Section.BaseVertexIndex;
+	const int32 NumVertices = FMath::Min<int32>(Section.NumVertices, VertexBuffer.Num() - BaseVertexIndex);
+	const bool bHasColors = ColorBuffer.Num() == VertexBuffer.Num();
+
+	// work on section local indices
+	TArrayView<uint32> Indices(IndexBuffer.GetData() + Section.BaseIndex, FMath::Min<int32>(Section.NumTriangles * 3, IndexBuffer.Num() - Section.BaseIndex));
+	for (uint32& Index : Indices)
+	{
+		Index -= BaseVertexIndex;
+	}
+
+	const int32 NumCacheMissesBefore = CMMeshOptimization::CountVertexCacheMisses(Indices, NumVertices);
+	CMMeshOptimization::OptimizeVertexCache(Indices, NumVertices);
+
+	TScratchArray<int32> OldToNew;
+	CMMeshOptimization::ReorderVerticesByFirstUse(Indices, NumVertices, OldToNew);
+	const int32 NumCacheMissesAfter = CMMeshOptimization::CountVertexCacheMisses(Indices, NumVertices);
+
+	for (uint32& Index : Indices)
+	{
+		Index += BaseVertexIndex;
+	}
+
+	// permute the vertex streams through a scratch copy
+	{
+		TScratchArray<VertexDataType> Vertices;
+		Vertices.Append(VertexBuffer.GetData() + BaseVertexIndex, NumVertices);
+		for (int32 VertIdx = 0; VertIdx < NumVertices; VertIdx++)
+		{
+			VertexBuffer[BaseVertexIndex + OldToNew[VertIdx]] = Vertices[VertIdx];
+		}
+	}
+	{
+		TScratchArray<FSkinWeightInfo> SkinWeights;
+		SkinWeights.Append(SkinWeightBuffer.GetData() + BaseVertexIndex, NumVertices);
+		for (int32 VertIdx = 0; VertIdx < NumVertices; VertIdx++)
+		{
+			SkinWeightBuffer[BaseVertexIndex + OldToNew[VertIdx]] = SkinWeights[VertIdx];
+		}
+	}
+	if (bHasColors)
+	{
+		TScratchArray<FColor> Colors;
+		Colors.Append(ColorBuffer.GetData() + BaseVertexIndex, NumVertices);
+		for (int32 VertIdx = 0; VertIdx < NumVertices; VertIdx++)
+		{
+			ColorBuffer[BaseVertexIndex + OldToNew[VertIdx]] = Colors[VertIdx];
+		}
+	}
+
+	// source vertices follow their reordered vertex
+	for (const FMergeSectionInfo& MergeSectionInfo : NewSectionInfo.MergeSections)
+	{
+		const int32 SrcBaseVertexIndex = MergeSectionInfo.Section->BaseVertexIndex;
+		const int32 NumSrcVertices = FMath::Min<int32>(MergeSectionInfo.Section->NumVertices, SourceVertexRemap.GetMeshRemap(MergeSectionInfo.MeshIdx).Num() - SrcBaseVertexIndex);
+		for (int32 VertIdx = 0; VertIdx < NumSrcVertices; VertIdx++)
+		{
+			int32& MergedVertIdx = SourceVertexRemap.Get(MergeSectionInfo.MeshIdx, SrcBaseVertexIndex + VertIdx);
+			if (MergedVertIdx != INDEX_NONE)
+			{
+				MergedVertIdx = BaseVertexIndex + OldToNew[MergedVertIdx - BaseVertexIndex];
+			}
+		}
+	}
+
+	MergeStats.NumCacheOptimizedTriangles += Indices.Num() / 3;
+	MergeStats.NumCacheMissesBefore += NumCacheMissesBefore;
+	MergeStats.NumCacheMissesAfter += NumCacheMissesAfter;
+	INC_DWORD_STAT_BY(STAT_CharacterMerger_NumCacheMissesBefore, NumCacheMissesBefore);
+	INC_DWORD_STAT_BY(STAT_CharacterMerger_NumCacheMissesAfter, NumCacheMissesAfter);
+
+	UE_LOG(LogCharacterMerger, Verbose, TEXT("Material %d section: ACMR %.3f -> %.3f over %d triangles"), Section.MaterialIndex,
+		Indices.Num() > 0 ? 3.f * NumCacheMissesBefore / Indices.Num() : 0.f, Indices.Num() > 0 ? 3.f * NumCacheMissesAfter / Indices.Num() : 0.f, Indices.Num() / 3);
+}
+
+/**
+* Creates a new LOD model and adds the new merged sections to it. Modifies the MergedMesh.
+* @param LODIdx - current LOD to process
+*/
+template<typename VertexDataType>
+void FCMSkeletalMeshMerge::GenerateLODModel( int32 LODIdx )
+{
+	CM_SCOPE_CYCLE_COUNTER(STAT_CharacterMerger_GenerateLODModel);
+	CM_LLM_SCOPE(MergeScratch);
+
+	// every temporary of this LOD is allocated from the thread's scratch arena and released with the mark
+	FMemStack& ScratchArena = FMemStack::Get();
+	FMemMark ScratchMark(ScratchArena);
+	const int64 ScratchStartBytes = ScratchArena.GetByteCount();
+
+	// add the new LOD model entry
+	FSkeletalMeshRenderData* MergeResource = MergeMesh->GetResourceForRendering();
+	check(MergeResource);
+
+	FSkeletalMeshLODRenderData* NewLODData = nullptr;
+	{
+		CM_LLM_SCOPE(MergedLODRenderData);
+		NewLODData = new FSkeletalMeshLODRenderData;
+		MergeResource->LODRenderData.Add(NewLODData);
+	}
+	FSkeletalMeshLODRenderData& MergeLODData = *NewLODData;
+	const int32 MergeLODIdx = MergeResource->LODRenderData.Num()-1;
 	// add the new LOD info entry
 	FSkeletalMeshLODInfo& MergeLODInfo = MergeMesh->AddLODInfo();
-	MergeLODInfo.ScreenSize = MergeLODInfo.LODHysteresis = MAX_FLT;
+	ComputeMergedLODScreenSize(MergeLODInfo, LODIdx);
 
 	// generate an array with info about new sections that need to be created
-	TArray<FNewSectionInfo> NewSectionArray;
-	GenerateNewSectionArray( NewSectionArray, LODIdx );
+	TScratchArray<FNewSectionInfo> NewSectionArray;
+	TScratchArray<FBoneIndexType> BoneMapStorage;
+	GenerateNewSectionArray( NewSectionArray, BoneMapStorage, LODIdx );
+
+	// count the merged vertices and indices up front so every buffer is allocated once
+	int32 NumMergedVertices = 0;
+	int32 NumMergedIndices = 0;
+	for (const FNewSectionInfo& NewSectionInfo : NewSectionArray)
+	{
+		for (const FMergeSectionInfo& MergeSectionInfo : NewSectionInfo.MergeSections)
+		{
+			NumMergedVertices += MergeSectionInfo.Section->NumVertices;
+			NumMergedIndices += MergeSectionInfo.Section->NumTriangles * 3;
+		}
+	}
+
+	// merged vertex index of every source vertex, used to remap duplicated vertices and morph targets
+	FSourceVertexRemap SourceVertexRemap;
+	SourceVertexRemap.MeshOffsets.SetNumUninitialized(SrcMeshList.Num() + 1);
+	int32 NumSrcVertices = 0;
+	for (int32 MeshIdx = 0; MeshIdx < SrcMeshList.Num(); MeshIdx++)
+	{
+		SourceVertexRemap.MeshOffsets[MeshIdx] = NumSrcVertices;
+		if (SrcMeshList[MeshIdx])
+		{
+			NumSrcVertices += GetSourceLODData(MeshIdx, LODIdx).GetNumVertices();
+		}
+	}
+	SourceVertexRemap.MeshOffsets[SrcMeshList.Num()] = NumSrcVertices;
+	SourceVertexRemap.MergedVertexIndices.Init(INDEX_NONE, NumSrcVertices);
+	SourceVertexRemap.OwnsMergedVertex.Init(true, NumSrcVertices);
+
+	// morph targets with a fixed weight are applied while copying the vertices
+	TScratchArray<FVector> BakedPositionDeltas;
+	TScratchArray<FVector> BakedTangentZDeltas;
+	const int32 NumBakedMorphs = GetBakedMorphDeltas(LODIdx, SourceVertexRemap, BakedPositionDeltas, BakedTangentZDeltas);
 
 	uint32 MaxIndex = 0;
+	int32 NumWeldedVertices = 0;
+	int32 NumHiddenTriangles = 0;
+	// triangles of the current merge section hidden under outer layers
+	TScratchArray<bool> HiddenTriangles;
 
 	// merged vertex buffer
-	TArray< VertexDataType > MergedVertexBuffer;
-	// merged skin weight buffer
+	TScratchArray< VertexDataType > MergedVertexBuffer;
+	MergedVertexBuffer.Reserve(NumMergedVertices);
+	// merged skin weight buffer (handed to the skin weight vertex buffer as is, so it stays on the heap)
 	TArray< FSkinWeightInfo > MergedSkinWeightBuffer;
+	MergedSkinWeightBuffer.Reserve(NumMergedVertices);
+	// streams the materials of this LOD read
+	const FCMSkelMeshVertexStreams UsedVertexStreams = GetUsedVertexStreams(NewSectionArray);
+	const bool bMergeVertexColors = MergeMesh->GetHasVertexColors() && UsedVertexStreams.bVertexColors;
+
 	// merged vertex color buffer
-	TArray< FColor > MergedColorBuffer;
-	// merged index buffer
+	TScratchArray< FColor > MergedColorBuffer;
+	if( bMergeVertexColors )
+	{
+		MergedColorBuffer.Reserve(NumMergedVertices);
+	}
+	// merged index buffer (handed to the index container as is, so it stays on the heap)
 	TArray<uint32> MergedIndexBuffer;
+	MergedIndexBuffer.Reserve(NumMergedIndices);
 
 	// The total number of UV sets for this LOD model
 	uint32 TotalNumUVs = 0;
 
 	uint32 SourceMaxBoneInfluences = 0;
+	const int32 LODMaxBoneInfluences = GetMaxBoneInfluences(LODIdx);
+	const bool bVariableBoneInfluences = Options.bVariableBoneInfluences && FGPUBaseSkinVertexFactory::GetUnlimitedBoneInfluences();
+	int32 NumPrunedInfluences = 0;
 	bool bSourceUse16BitBoneIndex = false;
 
+	// min/max reduction of the copied positions, the mesh bounds come from the first merged LOD
+	const bool bComputeVertexBounds = MergeLODIdx == 0 && Options.Bounds == ECMMergedBounds::MergedVertices;
+	VectorRegister VertexBoundsMin = VectorSetFloat1(MAX_flt);
+	VectorRegister VertexBoundsMax = VectorSetFloat1(-MAX_flt);
+
 	for( int32 CreateIdx=0; CreateIdx < NewSectionArray.Num(); CreateIdx++ )
 	{
 		FNewSectionInfo& NewSectionInfo = NewSectionArray[CreateIdx];
@@ -587,7 +2339,8 @@ void FCMSkeletalMeshMerge::GenerateLODModel( int32 LODIdx )
 
 		// set the new bonemap from the merged sections
 		// these are the bones that will be used by this new section
-		Section.BoneMap = NewSectionInfo.MergedBoneMap;
+		Section.BoneMap.Reset(NewSectionInfo.MergedBoneMap.Num());
+		Section.BoneMap.Append(NewSectionInfo.MergedBoneMap);
 
 		// init vert totals
 		Section.NumVertices = 0;
@@ -633,7 +2386,7 @@ void FCMSkeletalMeshMerge::GenerateLODModel( int32 LODIdx )
 		for( int32 MergeIdx=0; MergeIdx < NewSectionInfo.MergeSections.Num(); MergeIdx++ )
 		{
 			FMergeSectionInfo& MergeSectionInfo = NewSectionInfo.MergeSections[MergeIdx];
-			int32 SourceLODIdx = FMath::Min(LODIdx, MergeSectionInfo.SkelMesh->GetResourceForRendering()->LODRenderData.Num()-1);
+			int32 SourceLODIdx = GetSourceLODIndex(MergeSectionInfo.MeshIdx, LODIdx);
 
 			// Take the max UV density for each UVChannel between all sections that are being merged.
 			const int32 NewSectionMatId = MergeSectionInfo.Section->MaterialIndex;
@@ -652,27 +2405,8 @@ void FCMSkeletalMeshMerge::GenerateLODModel( int32 LODIdx )
 			// get the source skel LOD info from this merge entry
 			const FSkeletalMeshLODInfo& SrcLODInfo = *(MergeSectionInfo.SkelMesh->GetLODInfo(SourceLODIdx));
 
-			// keep track of the lowest LOD displayfactor and hysteresis
-			MergeLODInfo.ScreenSize.Default = FMath::Min<float>(MergeLODInfo.ScreenSize.Default, SrcLODInfo.ScreenSize.Default);
-#if WITH_EDITORONLY_DATA
-			for(const TPair<FName, float>& PerPlatform : SrcLODInfo.ScreenSize.PerPlatform)
-			{
-				float* Value = MergeLODInfo.ScreenSize.PerPlatform.Find(PerPlatform.Key);
-				if(Value)
-				{
-					*Value = FMath::Min<float>(PerPlatform.Value, *Value);	
-				}
-				else
-				{
-					MergeLODInfo.ScreenSize.PerPlatform.Add(PerPlatform.Key, PerPlatform.Value);
-				}
-			}
-#endif
-			MergeLODInfo.BuildSettings.bUseFullPrecisionUVs |= SrcLODInfo.BuildSettings.bUseFullPrecisionUVs;
 			MergeLODInfo.BuildSettings.bUseHighPrecisionTangentBasis |= SrcLODInfo.BuildSettings.bUseHighPrecisionTangentBasis;
 
-			MergeLODInfo.LODHysteresis = FMath::Min<float>(MergeLODInfo.LODHysteresis,SrcLODInfo.LODHysteresis);
-
 			// get the source skel LOD model from this merge entry
 			const FSkeletalMeshLODRenderData& SrcLODData = MergeSectionInfo.SkelMesh->GetResourceForRendering()->LODRenderData[SourceLODIdx];
 
@@ -707,123 +2441,171 @@ void FCMSkeletalMeshMerge::GenerateLODModel( int32 LODIdx )
 			int32 CurrentBaseVertexIndex = MergedVertexBuffer.Num();
 			const uint32 MaxBoneInfluences = SrcLODData.GetSkinWeightVertexBuffer()->GetMaxBoneInfluences();
 			const bool bUse16BitBoneIndex = SrcLODData.GetSkinWeightVertexBuffer()->Use16BitBoneIndex();
-			for( int32 VertIdx=MergeSectionInfo.Section->BaseVertexIndex; VertIdx < MaxVertIdx; VertIdx++ )
 			{
-				// add the new vertex
-				VertexDataType& DestVert = MergedVertexBuffer[MergedVertexBuffer.AddUninitialized()];
-				FSkinWeightInfo& DestWeight = MergedSkinWeightBuffer[MergedSkinWeightBuffer.AddUninitialized()];
+				CM_SCOPE_MERGE_PHASE(STAT_CharacterMerger_CopyVertices, CopyVertices);
+				for( int32 VertIdx=MergeSectionInfo.Section->BaseVertexIndex; VertIdx < MaxVertIdx; VertIdx++ )
+				{
+					// add the new vertex
+					const int32 DestVertIdx = MergedVertexBuffer.AddUninitialized();
+					VertexDataType& DestVert = MergedVertexBuffer[DestVertIdx];
+					SourceVertexRemap.Get(MergeSectionInfo.MeshIdx, VertIdx) = DestVertIdx;
+					FSkinWeightInfo& DestWeight = MergedSkinWeightBuffer[MergedSkinWeightBuffer.AddUninitialized()];
 
-				CopyVertexFromSource<VertexDataType>(DestVert, SrcLODData, VertIdx, MergeSectionInfo);
+					CopyVertexFromSource<VertexDataType>(DestVert, SrcLODData, VertIdx, MergeSectionInfo);
 
-				SourceMaxBoneInfluences = FMath::Max(SourceMaxBoneInfluences, MaxBoneInfluences);
-				bSourceUse16BitBoneIndex |= bUse16BitBoneIndex;
-				DestWeight = SrcLODData.GetSkinWeightVertexBuffer()->GetVertexSkinWeights(VertIdx);
+					if (NumBakedMorphs > 0)
+					{
+						const int32 SrcVertKey = SourceVertexRemap.MeshOffsets[MergeSectionInfo.MeshIdx] + VertIdx;
+						DestVert.Position += BakedPositionDeltas[SrcVertKey];
 
-				// if the mesh uses vertex colors, copy the source color if possible or default to white
-				if( MergeMesh->GetHasVertexColors() )
-				{
-					if( VertIdx < MaxColorIdx )
+						// like the GPU morph blend, offset the normal and orthogonalize the tangent against it
+						const FVector& TangentZDelta = BakedTangentZDeltas[SrcVertKey];
+						if (!TangentZDelta.IsNearlyZero())
+						{
+							const FVector4 SrcTangentZ = DestVert.TangentZ.ToFVector4();
+							const FVector TangentZ = (FVector(SrcTangentZ) + TangentZDelta).GetSafeNormal();
+							const FVector SrcTangentX = DestVert.TangentX.ToFVector();
+							const FVector TangentX = (SrcTangentX - (SrcTangentX | TangentZ) * TangentZ).GetSafeNormal();
+							DestVert.TangentX = TangentX;
+							DestVert.TangentZ = FVector4(TangentZ, SrcTangentZ.W);
+						}
+					}
+
+					if (MergeSectionInfo.InstanceIndex != INDEX_NONE)
+					{
+						checkSlow(Options.MaterialInstanceMerge.InstanceIndexUVChannel < (int32)VertexDataType::NumTexCoords);
+						DestVert.UVs[Options.MaterialInstanceMerge.InstanceIndexUVChannel] = FVector2D((float)MergeSectionInfo.InstanceIndex, 0.f);
+					}
+
+					if (bComputeVertexBounds)
 					{
-						const FColor& SrcColor = SrcLODData.StaticVertexBuffers.ColorVertexBuffer.VertexColor(VertIdx);
-						MergedColorBuffer.Add(SrcColor);
+						const VectorRegister Position = VectorLoadFloat3(&DestVert.Position);
+						VertexBoundsMin = VectorMin(VertexBoundsMin, Position);
+						VertexBoundsMax = VectorMax(VertexBoundsMax, Position);
 					}
-					else
+
+					SourceMaxBoneInfluences = FMath::Max(SourceMaxBoneInfluences, MaxBoneInfluences);
+					bSourceUse16BitBoneIndex |= bUse16BitBoneIndex;
+					DestWeight = SrcLODData.GetSkinWeightVertexBuffer()->GetVertexSkinWeights(VertIdx);
+
+					// if the mesh uses vertex colors, copy the source color if possible or default to white
+					if( bMergeVertexColors )
 					{
-						const FColor ColorWhite(255, 255, 255);
-						MergedColorBuffer.Add(ColorWhite);
+						if( VertIdx < MaxColorIdx )
+						{
+							const FColor& SrcColor = SrcLODData.StaticVertexBuffers.ColorVertexBuffer.VertexColor(VertIdx);
+							MergedColorBuffer.Add(SrcColor);
+						}
+						else
+						{
+							const FColor ColorWhite(255, 255, 255);
+							MergedColorBuffer.Add(ColorWhite);
+						}
 					}
-				}
 
-				uint32 LODNumTexCoords = SrcLODData.StaticVertexBuffers.StaticMeshVertexBuffer.GetNumTexCoords();
-				if( TotalNumUVs < LODNumTexCoords )
-				{
-					TotalNumUVs = LODNumTexCoords;
-				}
+					uint32 LODNumTexCoords = SrcLODData.StaticVertexBuffers.StaticMeshVertexBuffer.GetNumTexCoords();
+					if( TotalNumUVs < LODNumTexCoords )
+					{
+						TotalNumUVs = LODNumTexCoords;
+					}
 
-				// remap the bone index used by this vertex to match the mergedbonemap 
-				for( uint32 Idx=0; Idx < MAX_TOTAL_INFLUENCES; Idx++ )
-				{
-					if (DestWeight.InfluenceWeights[Idx] > 0)
+					// remap the bone index used by this vertex to match the mergedbonemap 
+					for( uint32 Idx=0; Idx < MAX_TOTAL_INFLUENCES; Idx++ )
+					{
+						if (DestWeight.InfluenceWeights[Idx] > 0)
+						{
+							checkSlow(MergeSectionInfo.BoneMapToMergedBoneMap.IsValidIndex(DestWeight.InfluenceBones[Idx]));
+							DestWeight.InfluenceBones[Idx] = (uint8)MergeSectionInfo.BoneMapToMergedBoneMap[DestWeight.InfluenceBones[Idx]];
+						}
+					}
+
+					if (LODMaxBoneInfluences > 0)
+					{
+						NumPrunedInfluences += LimitBoneInfluences(DestWeight, LODMaxBoneInfluences);
+					}
+
+					if (bVariableBoneInfluences)
 					{
-						checkSlow(MergeSectionInfo.BoneMapToMergedBoneMap.IsValidIndex(DestWeight.InfluenceBones[Idx]));
-						DestWeight.InfluenceBones[Idx] = (uint8)MergeSectionInfo.BoneMapToMergedBoneMap[DestWeight.InfluenceBones[Idx]];
+						CompactBoneInfluences(DestWeight);
 					}
 				}
 			}
 
+			// drop the triangles hidden under outer layers
+			const int32 NumHiddenSectionTriangles = GetHiddenTriangles(MergeSectionInfo, LODIdx, HiddenTriangles);
+			NumHiddenTriangles += NumHiddenSectionTriangles;
+
 			// update total number of triangles
-			Section.NumTriangles += MergeSectionInfo.Section->NumTriangles;
+			Section.NumTriangles += MergeSectionInfo.Section->NumTriangles - NumHiddenSectionTriangles;
 
 			// add the indices from the original source mesh to the merged index buffer					
 			int32 MaxIndexIdx = FMath::Min<int32>( 
 				MergeSectionInfo.Section->BaseIndex + MergeSectionInfo.Section->NumTriangles * 3, 
 				SrcLODData.MultiSizeIndexContainer.GetIndexBuffer()->Num()
 				);
-            for (int32 IndexIdx = MergeSectionInfo.Section->BaseIndex; IndexIdx < MaxIndexIdx; IndexIdx++)
-            {
-                uint32 SrcIndex = SrcLODData.MultiSizeIndexContainer.GetIndexBuffer()->Get(IndexIdx);
-
-                // add offset to each index to match the new entries in the merged vertex buffer
-                checkSlow(SrcIndex >= MergeSectionInfo.Section->BaseVertexIndex);
-                uint32 DstIndex = SrcIndex - MergeSectionInfo.Section->BaseVertexIndex + CurrentBaseVertexIndex;
-                checkSlow(DstIndex < (uint32)MergedVertexBuffer.Num());
-
-                // add the new index to the merged vertex buffer
-                MergedIndexBuffer.Add(DstIndex);
-                if (MaxIndex < DstIndex)
-                {
-                    MaxIndex = DstIndex;
-                }
-
-            }
-
             {
-                if (MergeSectionInfo.Section->DuplicatedVerticesBuffer.bHasOverlappingVertices)
+                CM_SCOPE_MERGE_PHASE(STAT_CharacterMerger_RemapIndices, RemapIndices);
+                for (int32 IndexIdx = MergeSectionInfo.Section->BaseIndex; IndexIdx < MaxIndexIdx; IndexIdx++)
                 {
-                    if (Section.DuplicatedVerticesBuffer.bHasOverlappingVertices)
+                    if (NumHiddenSectionTriangles > 0 && HiddenTriangles[(IndexIdx - MergeSectionInfo.Section->BaseIndex) / 3])
                     {
-                        // Merge
-                        int32 StartIndex = Section.DuplicatedVerticesBuffer.DupVertData.Num();
-                        int32 StartVertex = Section.DuplicatedVerticesBuffer.DupVertIndexData.Num();
-                        Section.DuplicatedVerticesBuffer.DupVertData.ResizeBuffer(StartIndex + MergeSectionInfo.Section->DuplicatedVerticesBuffer.DupVertData.Num());
-                        Section.DuplicatedVerticesBuffer.DupVertIndexData.ResizeBuffer(Section.NumVertices);
-                    
-                        uint8* VertData = Section.DuplicatedVerticesBuffer.DupVertData.GetDataPointer();
-                        uint8* IndexData = Section.DuplicatedVerticesBuffer.DupVertIndexData.GetDataPointer();
-                        for (int32 i = StartIndex; i < Section.DuplicatedVerticesBuffer.DupVertData.Num(); ++i)
-                        {
-                            *((uint32*)(VertData + i * sizeof(uint32))) += CurrentBaseVertexIndex - MergeSectionInfo.Section->BaseVertexIndex;
-                        }
-                        for (uint32 i = StartVertex; i < Section.NumVertices; ++i)
-                        {
-                            ((FIndexLengthPair*)(IndexData + i * sizeof(FIndexLengthPair)))->Index += StartIndex;
-                        }
+                        continue;
                     }
-                    else
+
+                    uint32 SrcIndex = SrcLODData.MultiSizeIndexContainer.GetIndexBuffer()->Get(IndexIdx);
+
+                    // add offset to each index to match the new entries in the merged vertex buffer
+                    checkSlow(SrcIndex >= MergeSectionInfo.Section->BaseVertexIndex);
+                    uint32 DstIndex = SrcIndex - MergeSectionInfo.Section->BaseVertexIndex + CurrentBaseVertexIndex;
+                    checkSlow(DstIndex < (uint32)MergedVertexBuffer.Num());
+
+                    // add the new index to the merged vertex buffer
+                    MergedIndexBuffer.Add(DstIndex);
+                    if (MaxIndex < DstIndex)
                     {
-                        Section.DuplicatedVerticesBuffer.DupVertData = MergeSectionInfo.Section->DuplicatedVerticesBuffer.DupVertData;
-                        Section.DuplicatedVerticesBuffer.DupVertIndexData = MergeSectionInfo.Section->DuplicatedVerticesBuffer.DupVertIndexData;
-                        uint8* VertData = Section.DuplicatedVerticesBuffer.DupVertData.GetDataPointer();
-                        for (int32 i = 0; i < Section.DuplicatedVerticesBuffer.DupVertData.Num(); ++i)
-                        {
-                            *((uint32*)(VertData + i * sizeof(uint32))) += CurrentBaseVertexIndex - MergeSectionInfo.Section->BaseVertexIndex;
-                        }
+                        MaxIndex = DstIndex;
                     }
-                    Section.DuplicatedVerticesBuffer.bHasOverlappingVertices = true;
-                }
-                else
-                {
-                    Section.DuplicatedVerticesBuffer.DupVertData.ResizeBuffer(1);
-                    Section.DuplicatedVerticesBuffer.DupVertIndexData.ResizeBuffer(Section.NumVertices);
-
-                    uint8* VertData = Section.DuplicatedVerticesBuffer.DupVertData.GetDataPointer();
-                    uint8* IndexData = Section.DuplicatedVerticesBuffer.DupVertIndexData.GetDataPointer();
-                    
-                    FMemory::Memzero(IndexData, Section.NumVertices * sizeof(FIndexLengthPair));
-                    FMemory::Memzero(VertData, sizeof(uint32));
+
                 }
             }
 		}
+
+		if (Options.bWeldVertices)
+		{
+			NumWeldedVertices += WeldSectionVertices(Section, NewSectionInfo, MergedVertexBuffer, MergedSkinWeightBuffer, MergedColorBuffer, MergedIndexBuffer, SourceVertexRemap);
+			MaxIndex = FMath::Min<uint32>(MaxIndex, FMath::Max(MergedVertexBuffer.Num() - 1, 0));
+		}
+	}
+
+	if (bComputeVertexBounds && MergedVertexBuffer.Num() > 0)
+	{
+		VectorStoreFloat3(VertexBoundsMin, &MergedVertexBounds.Min);
+		VectorStoreFloat3(VertexBoundsMax, &MergedVertexBounds.Max);
+		MergedVertexBounds.IsValid = 1;
+	}
+
+	int32 NumSimplifiedTriangles = 0;
+	if (Options.bSimplifyReusedLODs)
+	{
+		NumSimplifiedTriangles = SimplifySections(NewSectionArray, MergeLODData.RenderSections, LODIdx, MergedVertexBuffer, MergedSkinWeightBuffer, MergedColorBuffer, MergedIndexBuffer, SourceVertexRemap);
+		MaxIndex = FMath::Min<uint32>(MaxIndex, FMath::Max(MergedVertexBuffer.Num() - 1, 0));
+	}
+
+	// passes that need the final vertices of every section
+	for( int32 SectionIdx=0; SectionIdx < MergeLODData.RenderSections.Num(); SectionIdx++ )
+	{
+		FSkelMeshRenderSection& Section = MergeLODData.RenderSections[SectionIdx];
+		const FNewSectionInfo& NewSectionInfo = NewSectionArray[SectionIdx];
+
+		if (Options.bOptimizeVertexCache)
+		{
+			OptimizeSectionVertexCache(Section, NewSectionInfo, MergedVertexBuffer, MergedSkinWeightBuffer, MergedColorBuffer, MergedIndexBuffer, SourceVertexRemap);
+		}
+
+		{
+			CM_LLM_SCOPE(MergedLODRenderData);
+			GenerateDuplicatedVertices(Section, NewSectionInfo, SourceVertexRemap);
+		}
 	}
 
     const bool bNeedsCPUAccess = (MeshBufferAccess == EMeshBufferAccess::ForceCPUAndGPU) ||
@@ -832,44 +2614,137 @@ void FCMSkeletalMeshMerge::GenerateLODModel( int32 LODIdx )
 	// sort required bone array in strictly increasing order
 	MergeLODData.RequiredBones.Sort();
 	MergeMesh->GetRefSkeleton().EnsureParentsExistAndSort(MergeLODData.ActiveBoneIndices);
-	
-	// copy the new vertices and indices to the vertex buffer for the new model
-	MergeLODData.StaticVertexBuffers.StaticMeshVertexBuffer.SetUseFullPrecisionUVs(MergeLODInfo.BuildSettings.bUseFullPrecisionUVs);
 
-	MergeLODData.StaticVertexBuffers.PositionVertexBuffer.Init(MergedVertexBuffer.Num(), bNeedsCPUAccess);
-	MergeLODData.StaticVertexBuffers.StaticMeshVertexBuffer.Init(MergedVertexBuffer.Num(), TotalNumUVs, bNeedsCPUAccess);
+	MergeStats.NumActiveBonesBeforePruning += MergeLODData.ActiveBoneIndices.Num();
+	if (Options.bPruneUnweightedBones)
+	{
+		// the bone maps of the merged sections can hold bones that no remaining vertex uses
+		ComputeWeightedLODBones(MergeLODData, MergedSkinWeightBuffer);
+	}
+	MergeStats.NumActiveBones += MergeLODData.ActiveBoneIndices.Num();
 
-	for (int i = 0; i < MergedVertexBuffer.Num(); i++)
+	// no source part has the instance index channel, it is added to the merged vertices
+	const uint32 InstanceIndexNumUVs = bMergeMaterialInstances ? (uint32)Options.MaterialInstanceMerge.InstanceIndexUVChannel + 1 : 0;
+	TotalNumUVs = FMath::Max(TotalNumUVs, InstanceIndexNumUVs);
+	check(TotalNumUVs <= VertexDataType::NumTexCoords);
+
+	// drop the trailing UV channels no material reads, the channels in front of a read one have to stay to keep its index
+	const uint32 SourceNumUVs = TotalNumUVs;
+	TotalNumUVs = FMath::Clamp<uint32>(FMath::FloorLog2(UsedVertexStreams.UVChannelMask) + 1, 1, FMath::Max(TotalNumUVs, 1u));
+	checkf(TotalNumUVs >= InstanceIndexNumUVs, TEXT("The instance index UV channel %d must be uploaded"), Options.MaterialInstanceMerge.InstanceIndexUVChannel);
+	
 	{
-		MergeLODData.StaticVertexBuffers.PositionVertexBuffer.VertexPosition(i) = MergedVertexBuffer[i].Position;
-		MergeLODData.StaticVertexBuffers.StaticMeshVertexBuffer.SetVertexTangents(i, MergedVertexBuffer[i].TangentX.ToFVector(), MergedVertexBuffer[i].GetTangentY(), MergedVertexBuffer[i].TangentZ.ToFVector());
-		for (uint32 j = 0; j < TotalNumUVs; j++)
+		CM_LLM_SCOPE(MergedLODRenderData);
+
+		// the merged UVs went through the vertex type precision, the tangents through 8 bit packed normals
+		MergeLODInfo.BuildSettings.bUseFullPrecisionUVs = VertexDataType::StaticMeshVertexUVType == EStaticMeshVertexUVType::HighPrecision;
+		if (GetVertexFormatPolicy(LODIdx) != ECMVertexFormatPolicy::Source)
 		{
-			MergeLODData.StaticVertexBuffers.StaticMeshVertexBuffer.SetVertexUV(i, j, MergedVertexBuffer[i].UVs[j]);
+			MergeLODInfo.BuildSettings.bUseHighPrecisionTangentBasis = false;
 		}
-	}
 
-	MergeLODData.SkinWeightVertexBuffer.SetMaxBoneInfluences(SourceMaxBoneInfluences);
-	MergeLODData.SkinWeightVertexBuffer.SetUse16BitBoneIndex(bSourceUse16BitBoneIndex);
-	MergeLODData.SkinWeightVertexBuffer.SetNeedsCPUAccess(bNeedsCPUAccess);
+		// copy the new vertices and indices to the vertex buffer for the new model
+		MergeLODData.StaticVertexBuffers.StaticMeshVertexBuffer.SetUseFullPrecisionUVs(MergeLODInfo.BuildSettings.bUseFullPrecisionUVs);
 
-	// copy vertex resource arrays
-	MergeLODData.SkinWeightVertexBuffer = MergedSkinWeightBuffer;
+		MergeLODData.StaticVertexBuffers.PositionVertexBuffer.Init(MergedVertexBuffer.Num(), bNeedsCPUAccess);
+		MergeLODData.StaticVertexBuffers.StaticMeshVertexBuffer.Init(MergedVertexBuffer.Num(), TotalNumUVs, bNeedsCPUAccess);
 
-	if( MergeMesh->GetHasVertexColors() )
-	{
-		MergeLODData.StaticVertexBuffers.ColorVertexBuffer.InitFromColorArray(MergedColorBuffer);
-	}
+		for (int i = 0; i < MergedVertexBuffer.Num(); i++)
+		{
+			MergeLODData.StaticVertexBuffers.PositionVertexBuffer.VertexPosition(i) = MergedVertexBuffer[i].Position;
+			MergeLODData.StaticVertexBuffers.StaticMeshVertexBuffer.SetVertexTangents(i, MergedVertexBuffer[i].TangentX.ToFVector(), MergedVertexBuffer[i].GetTangentY(), MergedVertexBuffer[i].TangentZ.ToFVector());
+			for (uint32 j = 0; j < TotalNumUVs; j++)
+			{
+				MergeLODData.StaticVertexBuffers.StaticMeshVertexBuffer.SetVertexUV(i, j, MergedVertexBuffer[i].UVs[j]);
+			}
+		}
 
-	
-	const uint8 DataTypeSize = (MaxIndex < MAX_uint16) ? sizeof(uint16) : sizeof(uint32);
-	MergeLODData.MultiSizeIndexContainer.RebuildIndexBuffer(DataTypeSize, MergedIndexBuffer);
+		if (LODMaxBoneInfluences > 0)
+		{
+			SourceMaxBoneInfluences = FMath::Min<uint32>(SourceMaxBoneInfluences, LODMaxBoneInfluences);
+			for (FSkelMeshRenderSection& Section : MergeLODData.RenderSections)
+			{
+				Section.MaxBoneInfluences = FMath::Min<int32>(Section.MaxBoneInfluences, LODMaxBoneInfluences);
+			}
+		}
+
+		MergeLODData.SkinWeightVertexBuffer.SetMaxBoneInfluences(SourceMaxBoneInfluences);
+		MergeLODData.SkinWeightVertexBuffer.SetUse16BitBoneIndex(bSourceUse16BitBoneIndex);
+		MergeLODData.SkinWeightVertexBuffer.SetNeedsCPUAccess(bNeedsCPUAccess);
+		MergeLODData.SkinWeightVertexBuffer.SetVariableBonesPerVertex(bVariableBoneInfluences);
+
+		// copy vertex resource arrays
+		MergeLODData.SkinWeightVertexBuffer = MergedSkinWeightBuffer;
+
+		if( bMergeVertexColors )
+		{
+			MergeLODData.StaticVertexBuffers.ColorVertexBuffer.InitFromColorArray(MergedColorBuffer.GetData(), MergedColorBuffer.Num());
+		}
+
+		const uint8 DataTypeSize = (MaxIndex < MAX_uint16) ? sizeof(uint16) : sizeof(uint32);
+		MergeLODData.MultiSizeIndexContainer.RebuildIndexBuffer(DataTypeSize, MergedIndexBuffer);
+	}
 
-	for(int It = 0; It < SrcMeshList.Num(); It++)
+	int32 NumMorphDeltas = 0;
+	int32 NumPrunedMorphDeltas = 0;
 	{
-		ParseMorphs(SrcMeshList[It], MergeMesh, It);
+		CM_SCOPE_MERGE_PHASE(STAT_CharacterMerger_ParseMorphs, ParseMorphs);
+		CM_LLM_SCOPE(MergedMorphTargets);
+		TMap<FName, TArray<FMorphTargetDelta>> CollapsedMorphDeltas;
+		for (int32 MeshIdx = 0; MeshIdx < SrcMeshList.Num(); MeshIdx++)
+		{
+			if (USkeletalMesh* SrcMesh = SrcMeshList[MeshIdx])
+			{
+				NumMorphDeltas += ParseMorphs(SrcMesh, GetSourceLODIndex(MeshIdx, LODIdx), SourceVertexRemap.GetMeshRemap(MeshIdx), SourceVertexRemap.GetMeshOwnership(MeshIdx),
+					MergeMesh, MergeLODIdx, Options, CollapsedMorphDeltas, NumPrunedMorphDeltas);
+			}
+		}
+		NumMorphDeltas -= FinalizeMorphLOD(MergeMesh, MergeLODIdx, CollapsedMorphDeltas, Options, NumPrunedMorphDeltas);
 	}
 
+	// update the per merge counters
+	FCMSkelMeshLODMemory LODMemory;
+	GetLODMemory(MergeLODData, LODMemory);
+	const int64 LODDataSize = LODMemory.GetTotal();
+	MergeStats.NumLODs++;
+	MergeStats.NumSections += MergeLODData.RenderSections.Num();
+	MergeStats.NumVertices += MergedVertexBuffer.Num();
+	MergeStats.NumIndices += MergedIndexBuffer.Num();
+	MergeStats.NumMorphDeltas += NumMorphDeltas;
+	MergeStats.NumPrunedMorphDeltas += NumPrunedMorphDeltas;
+	MergeStats.NumWeldedVertices += NumWeldedVertices;
+	MergeStats.NumHiddenTriangles += NumHiddenTriangles;
+	MergeStats.NumSimplifiedTriangles += NumSimplifiedTriangles;
+	MergeStats.NumPrunedInfluences += NumPrunedInfluences;
+	if (bVariableBoneInfluences)
+	{
+		// what fixed MaxBoneInfluences slots would have taken
+		const int64 InfluenceSize = (bSourceUse16BitBoneIndex ? sizeof(uint16) : sizeof(uint8)) + sizeof(FSkinWeightInfo::InfluenceWeights[0]);
+		const int64 FixedSkinWeightBytes = (int64)MergedSkinWeightBuffer.Num() * SourceMaxBoneInfluences * InfluenceSize;
+		const int64 SkinWeightBytesSaved = FixedSkinWeightBytes - LODMemory.SkinWeights;
+		MergeStats.NumSkinWeightBytesSaved += SkinWeightBytesSaved;
+		UE_LOG(LogCharacterMerger, Verbose, TEXT("LOD %d: variable bone influences take %lld skin weight bytes, %lld less than fixed influences"), MergeLODIdx, LODMemory.SkinWeights, SkinWeightBytesSaved);
+	}
+	const bool bDroppedVertexColors = MergeMesh->GetHasVertexColors() && !bMergeVertexColors;
+	if (TotalNumUVs < SourceNumUVs || bDroppedVertexColors)
+	{
+		const int32 UVSize = MergeLODInfo.BuildSettings.bUseFullPrecisionUVs ? sizeof(FVector2D) : sizeof(FVector2DHalf);
+		const int32 VertexBytesSaved = (SourceNumUVs - TotalNumUVs) * UVSize + (bDroppedVertexColors ? sizeof(FColor) : 0);
+		MergeStats.NumVertexStreamBytesSaved += (int64)VertexBytesSaved * MergedVertexBuffer.Num();
+		UE_LOG(LogCharacterMerger, Verbose, TEXT("LOD %d: keeps %u of %u UV channels and %s vertex colors, %d bytes less per vertex"), MergeLODIdx, TotalNumUVs, SourceNumUVs, bMergeVertexColors ? TEXT("its") : TEXT("no"), VertexBytesSaved);
+	}
+	MergeStats.NumBytes += LODDataSize;
+	MergeStats.PeakScratchBytes = FMath::Max<int64>(MergeStats.PeakScratchBytes, ScratchArena.GetByteCount() - ScratchStartBytes);
+
+	INC_DWORD_STAT_BY(STAT_CharacterMerger_NumSections, MergeLODData.RenderSections.Num());
+	INC_DWORD_STAT_BY(STAT_CharacterMerger_NumVertices, MergedVertexBuffer.Num());
+	INC_DWORD_STAT_BY(STAT_CharacterMerger_NumIndices, MergedIndexBuffer.Num());
+	INC_DWORD_STAT_BY(STAT_CharacterMerger_NumMorphDeltas, NumMorphDeltas);
+	INC_DWORD_STAT_BY(STAT_CharacterMerger_NumWeldedVertices, NumWeldedVertices);
+	INC_DWORD_STAT_BY(STAT_CharacterMerger_NumHiddenTriangles, NumHiddenTriangles);
+	INC_DWORD_STAT_BY(STAT_CharacterMerger_NumSimplifiedTriangles, NumSimplifiedTriangles);
+	INC_DWORD_STAT_BY(STAT_CharacterMerger_NumBytes, LODDataSize);
+	UpdateScratchArenaPeakStat(MergeStats.PeakScratchBytes);
 }
 
 /**
@@ -878,6 +2753,8 @@ void FCMSkeletalMeshMerge::GenerateLODModel( int32 LODIdx )
 */
 bool FCMSkeletalMeshMerge::ProcessMergeMesh()
 {
+	CM_SCOPE_CYCLE_COUNTER(STAT_CharacterMerger_ProcessMergeMesh);
+
 	bool Result=true;
 	
 	// copy settings and bone info from src meshes
@@ -909,6 +2786,12 @@ bool FCMSkeletalMeshMerge::ProcessMergeMesh()
 		}
 	}
 
+	// parts authored with loose bounds would inflate the sum of the imported bounds
+	if (MergedVertexBounds.IsValid)
+	{
+		MergeMesh->SetImportedBounds(FBoxSphereBounds(MergedVertexBounds));
+	}
+
 	// Rebuild inverse ref pose matrices.
 	MergeMesh->GetRefBasesInvMatrix().Empty();
 	MergeMesh->CalculateInvRefMatrices();
@@ -920,13 +2803,21 @@ int32 FCMSkeletalMeshMerge::CalculateLodCount(const TArray<USkeletalMesh*>& Sour
 {
 	int32 LodCount = INT_MAX;
 
-	for (int32 i = 0, MeshCount = SourceMeshList.Num(); i < MeshCount; ++i)
+	if (Options.LODCount == ECMMergedLODCount::MainBody && SourceMeshList.Num() > 0 && SourceMeshList[0])
 	{
-		USkeletalMesh* SourceMesh = SourceMeshList[i];
-
-		if (SourceMesh)
+		// the other parts reuse their closest LOD, see GetSourceLODIndex
+		LodCount = SourceMeshList[0]->GetLODNum();
+	}
+	else
+	{
+		for (int32 i = 0, MeshCount = SourceMeshList.Num(); i < MeshCount; ++i)
 		{
-			LodCount = FMath::Min<int32>(LodCount, SourceMesh->GetLODNum());
+			USkeletalMesh* SourceMesh = SourceMeshList[i];
+
+			if (SourceMesh)
+			{
+				LodCount = FMath::Min<int32>(LodCount, SourceMesh->GetLODNum());
+			}
 		}
 	}
 
@@ -935,6 +2826,11 @@ int32 FCMSkeletalMeshMerge::CalculateLodCount(const TArray<USkeletalMesh*>& Sour
 		return -1;
 	}
 
+	if (Options.bSimplifyReusedLODs)
+	{
+		LodCount += FMath::Max(Options.NumGeneratedLODs, 0);
+	}
+
 	// Decrease the number of LODs we are going to make based on StripTopLODs.
 	// But, make sure there is at least one.
 
@@ -1002,6 +2898,181 @@ void FCMSkeletalMeshMerge::BuildReferenceSkeleton(const TArray<USkeletalMesh*>&
 	}
 }
 
+void FCMSkeletalMeshMerge::GetKeptBones(const FReferenceSkeleton& RefSkeleton, TArrayView<bool> OutKeepBone) const
+{
+	auto KeepBone = [&RefSkeleton, &OutKeepBone](FName BoneName)
+	{
+		const int32 BoneIndex = RefSkeleton.FindRawBoneIndex(BoneName);
+		if (BoneIndex != INDEX_NONE)
+		{
+			OutKeepBone[BoneIndex] = true;
+		}
+	};
+
+	for (const USkeletalMeshSocket* Socket : MergeMesh->GetMeshOnlySocketList())
+	{
+		KeepBone(Socket->BoneName);
+	}
+
+	if (MergeMesh->GetSkeleton())
+	{
+		for (const USkeletalMeshSocket* Socket : MergeMesh->GetSkeleton()->Sockets)
+		{
+			KeepBone(Socket->BoneName);
+		}
+	}
+
+	for (const FName& BoneName : Options.KeepBones)
+	{
+		KeepBone(BoneName);
+	}
+}
+
+void FCMSkeletalMeshMerge::PruneUnweightedBones(FReferenceSkeleton& RefSkeleton, const USkeleton* SkeletonAsset)
+{
+	const int32 NumBones = RefSkeleton.GetRawBoneNum();
+	if (NumBones == 0)
+	{
+		return;
+	}
+
+	FMemMark Mark(FMemStack::Get());
+
+	TScratchArray<bool> KeepBone;
+	KeepBone.Init(false, NumBones);
+	KeepBone[0] = true;
+	GetKeptBones(RefSkeleton, KeepBone);
+
+	// bones weighted in any LOD of any part
+	for (USkeletalMesh* SrcMesh : SrcMeshList)
+	{
+		if (!SrcMesh)
+		{
+			continue;
+		}
+
+		const FReferenceSkeleton& SrcRefSkeleton = SrcMesh->GetRefSkeleton();
+		TScratchArray<bool> SrcBoneWeighted;
+		SrcBoneWeighted.Init(false, SrcRefSkeleton.GetRawBoneNum());
+
+		for (const FSkeletalMeshLODRenderData& SrcLODData : SrcMesh->GetResourceForRendering()->LODRenderData)
+		{
+			const FSkinWeightVertexBuffer* SrcSkinWeights = SrcLODData.GetSkinWeightVertexBuffer();
+			for (const FSkelMeshRenderSection& Section : SrcLODData.RenderSections)
+			{
+				const int32 EndVertIdx = FMath::Min<int32>(Section.BaseVertexIndex + Section.NumVertices, SrcSkinWeights->GetNumVertices());
+				for (int32 VertIdx = Section.BaseVertexIndex; VertIdx < EndVertIdx; VertIdx++)
+				{
+					const FSkinWeightInfo Weights = SrcSkinWeights->GetVertexSkinWeights(VertIdx);
+					for (int32 InfluenceIdx = 0; InfluenceIdx < MAX_TOTAL_INFLUENCES; InfluenceIdx++)
+					{
+						if (Weights.InfluenceWeights[InfluenceIdx] > 0 && Section.BoneMap.IsValidIndex(Weights.InfluenceBones[InfluenceIdx]))
+						{
+							SrcBoneWeighted[Section.BoneMap[Weights.InfluenceBones[InfluenceIdx]]] = true;
+						}
+					}
+				}
+			}
+		}
+
+		for (int32 SrcBoneIndex = 0; SrcBoneIndex < SrcBoneWeighted.Num(); SrcBoneIndex++)
+		{
+			if (SrcBoneWeighted[SrcBoneIndex])
+			{
+				const int32 BoneIndex = RefSkeleton.FindRawBoneIndex(SrcRefSkeleton.GetBoneName(SrcBoneIndex));
+				if (BoneIndex != INDEX_NONE)
+				{
+					KeepBone[BoneIndex] = true;
+				}
+			}
+		}
+	}
+
+	// parents always come before their children, so walking backwards reaches every ancestor
+	for (int32 BoneIndex = NumBones - 1; BoneIndex > 0; BoneIndex--)
+	{
+		if (KeepBone[BoneIndex])
+		{
+			KeepBone[RefSkeleton.GetRawParentIndex(BoneIndex)] = true;
+		}
+	}
+
+	// rebuild the skeleton from the kept bones, in the same order
+	FReferenceSkeleton PrunedRefSkeleton;
+	{
+		FReferenceSkeletonModifier RefSkelModifier(PrunedRefSkeleton, SkeletonAsset);
+
+		TScratchArray<int32> NewBoneIndices;
+		NewBoneIndices.Init(INDEX_NONE, NumBones);
+		int32 NumKeptBones = 0;
+		for (int32 BoneIndex = 0; BoneIndex < NumBones; BoneIndex++)
+		{
+			if (KeepBone[BoneIndex])
+			{
+				FMeshBoneInfo MeshBoneInfo = RefSkeleton.GetRawRefBoneInfo()[BoneIndex];
+				MeshBoneInfo.ParentIndex = BoneIndex > 0 ? NewBoneIndices[MeshBoneInfo.ParentIndex] : INDEX_NONE;
+
+				RefSkelModifier.Add(MeshBoneInfo, RefSkeleton.GetRawRefBonePose()[BoneIndex]);
+				NewBoneIndices[BoneIndex] = NumKeptBones++;
+			}
+		}
+	}
+
+	MergeStats.NumRefBones = PrunedRefSkeleton.GetRawBoneNum();
+	INC_DWORD_STAT_BY(STAT_CharacterMerger_NumPrunedBones, NumBones - PrunedRefSkeleton.GetRawBoneNum());
+	UE_LOG(LogCharacterMerger, Verbose, TEXT("Pruned merged skeleton from %d to %d bones"), NumBones, PrunedRefSkeleton.GetRawBoneNum());
+
+	RefSkeleton = PrunedRefSkeleton;
+}
+
+void FCMSkeletalMeshMerge::ComputeWeightedLODBones(FSkeletalMeshLODRenderData& LODData, TArrayView<const FSkinWeightInfo> SkinWeights) const
+{
+	const FReferenceSkeleton& RefSkeleton = MergeMesh->GetRefSkeleton();
+
+	FMemMark Mark(FMemStack::Get());
+
+	TScratchArray<bool> BoneWeighted;
+	BoneWeighted.Init(false, RefSkeleton.GetRawBoneNum());
+	for (const FSkelMeshRenderSection& Section : LODData.RenderSections)
+	{
+		const int32 EndVertIdx = FMath::Min<int32>(Section.BaseVertexIndex + Section.NumVertices, SkinWeights.Num());
+		for (int32 VertIdx = Section.BaseVertexIndex; VertIdx < EndVertIdx; VertIdx++)
+		{
+			const FSkinWeightInfo& Weights = SkinWeights[VertIdx];
+			for (int32 InfluenceIdx = 0; InfluenceIdx < MAX_TOTAL_INFLUENCES; InfluenceIdx++)
+			{
+				if (Weights.InfluenceWeights[InfluenceIdx] > 0 && Section.BoneMap.IsValidIndex(Weights.InfluenceBones[InfluenceIdx]))
+				{
+					BoneWeighted[Section.BoneMap[Weights.InfluenceBones[InfluenceIdx]]] = true;
+				}
+			}
+		}
+	}
+
+	LODData.ActiveBoneIndices.Reset();
+	for (int32 BoneIndex = 0; BoneIndex < BoneWeighted.Num(); BoneIndex++)
+	{
+		if (BoneWeighted[BoneIndex])
+		{
+			LODData.ActiveBoneIndices.Add(BoneIndex);
+		}
+	}
+
+	// required bones also evaluate the bones sockets and explicitly kept bones need
+	GetKeptBones(RefSkeleton, BoneWeighted);
+	LODData.RequiredBones.Reset();
+	for (int32 BoneIndex = 0; BoneIndex < BoneWeighted.Num(); BoneIndex++)
+	{
+		if (BoneWeighted[BoneIndex])
+		{
+			LODData.RequiredBones.Add(BoneIndex);
+		}
+	}
+
+	RefSkeleton.EnsureParentsExistAndSort(LODData.ActiveBoneIndices);
+	RefSkeleton.EnsureParentsExistAndSort(LODData.RequiredBones);
+}
+
 void FCMSkeletalMeshMerge::OverrideReferenceSkeletonPose(const TArray<FCMRefPoseOverride>& PoseOverrides, FReferenceSkeleton& TargetSkeleton, const USkeleton* SkeletonAsset)
 {
 	for (int32 i = 0, PoseMax = PoseOverrides.Num(); i < PoseMax; ++i)
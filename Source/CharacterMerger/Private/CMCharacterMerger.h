@@ -14,6 +14,8 @@ FCMSkeletalMeshMerge
 #include "Engine/EngineTypes.h"
 #include "ReferenceSkeleton.h"
 #include "Components.h"
+#include "CharacterMergerTypes.h"
+#include "Misc/MemStack.h"
 
 class UMaterialInterface;
 class USkeletalMesh;
@@ -82,6 +84,8 @@ struct FCMSkelMeshMergeSectionMapping
 {
 	/** indices to final section entries of the merged skel mesh */
 	TArray<int32> SectionIDs;
+	/** optional material of each section, drawn instead of the source material */
+	TArray<UMaterialInterface*> SectionMaterials;
 };
 
 /** 
@@ -93,6 +97,113 @@ struct FCMSkelMeshMergeUVTransforms
 	TArray<TArray<FTransform>> UVTransformsPerMesh;
 };
 
+/**
+* Phases of a merge, timed individually for profiling and hitch reports
+*/
+enum class ECMMergePhase : uint8
+{
+	BuildReferenceSkeleton,
+	BuildSockets,
+	PruneBones,
+	GenerateNewSectionArray,
+	CopyVertices,
+	RemapIndices,
+	WeldVertices,
+	HideTriangles,
+	Simplify,
+	OptimizeVertexCache,
+	ParseMorphs,
+	InitResources,
+	Num
+};
+
+/**
+* Timings and counters gathered while merging, reset at the start of every merge
+*/
+struct FCMSkelMeshMergeStats
+{
+	/** wall time spent in each merge phase, in seconds */
+	double PhaseSeconds[(int32)ECMMergePhase::Num];
+
+	/** number of LODs generated for the merged mesh */
+	int32 NumLODs;
+	/** number of render sections over all merged LODs */
+	int32 NumSections;
+	/** number of vertices over all merged LODs */
+	int32 NumVertices;
+	/** number of indices over all merged LODs */
+	int32 NumIndices;
+	/** number of morph targets kept in the merged mesh */
+	int32 NumMorphTargets;
+	/** number of morph target deltas written to the merged mesh */
+	int32 NumMorphDeltas;
+	/** number of source morph target deltas left out by the thresholds and the allow list */
+	int32 NumPrunedMorphDeltas;
+	/** number of vertices removed by welding */
+	int32 NumWeldedVertices;
+	/** number of triangles dropped by hide masks */
+	int32 NumHiddenTriangles;
+	/** number of triangles removed by simplifying the LODs parts reuse */
+	int32 NumSimplifiedTriangles;
+	/** triangles that went through the vertex cache optimization */
+	int32 NumCacheOptimizedTriangles;
+	/** vertex cache misses of those triangles before and after the optimization */
+	int32 NumCacheMissesBefore;
+	int32 NumCacheMissesAfter;
+	/** number of bone influences dropped by MaxBoneInfluencesPerLOD */
+	int32 NumPrunedInfluences;
+	/** skin weight memory saved by variable bone influences over fixed MaxBoneInfluences slots */
+	int64 NumSkinWeightBytesSaved;
+	/** vertex memory saved by dropping the UV channels and vertex colors no merged material reads */
+	int64 NumVertexStreamBytesSaved;
+	/** bones of the merged reference skeleton before and after pruning the unweighted ones */
+	int32 NumRefBonesBeforePruning;
+	int32 NumRefBones;
+	/** active bones over all merged LODs before and after pruning the unweighted ones */
+	int32 NumActiveBonesBeforePruning;
+	int32 NumActiveBones;
+	/** size of the vertex, skin weight, color and index data produced */
+	int64 NumBytes;
+	/** largest amount of scratch arena memory used by a single LOD */
+	int64 PeakScratchBytes;
+
+	FCMSkelMeshMergeStats()
+	{
+		Reset();
+	}
+
+	void Reset()
+	{
+		FMemory::Memzero(*this);
+	}
+
+	/** @return the sum of all phase timings, in seconds */
+	double GetTotalSeconds() const
+	{
+		double Total = 0.0;
+		for (int32 PhaseIdx = 0; PhaseIdx < (int32)ECMMergePhase::Num; PhaseIdx++)
+		{
+			Total += PhaseSeconds[PhaseIdx];
+		}
+		return Total;
+	}
+
+	/** @return average vertex cache miss ratio (misses per triangle) of the optimized sections before the optimization */
+	float GetACMRBefore() const
+	{
+		return NumCacheOptimizedTriangles > 0 ? (float)NumCacheMissesBefore / NumCacheOptimizedTriangles : 0.f;
+	}
+
+	/** @return average vertex cache miss ratio of the optimized sections after the optimization */
+	float GetACMRAfter() const
+	{
+		return NumCacheOptimizedTriangles > 0 ? (float)NumCacheMissesAfter / NumCacheOptimizedTriangles : 0.f;
+	}
+
+	/** @return display name of a merge phase */
+	static const TCHAR* GetPhaseName(ECMMergePhase Phase);
+};
+
 /** 
 * Utility for merging a list of skeletal meshes into a single mesh.
 */
@@ -107,6 +218,7 @@ public:
 	* @param StripTopLODs - number of high LODs to remove from input meshes
     * @param bMeshNeedsCPUAccess - (optional) if the resulting mesh needs to be accessed by the CPU for any reason (e.g. for spawning particle effects).
 	* @param UVTransforms - optional array to transform the UVs in each mesh
+	* @param InOptions - optional processing applied to the merged mesh
 	*/
 	FCMSkeletalMeshMerge( 
 		USkeletalMesh* InMergeMesh, 
@@ -114,7 +226,8 @@ public:
 		const TArray<FCMSkelMeshMergeSectionMapping>& InForceSectionMapping,
 		int32 StripTopLODs,
         EMeshBufferAccess MeshBufferAccess=EMeshBufferAccess::Default,
-		FCMSkelMeshMergeUVTransforms* InSectionUVTransforms = nullptr
+		FCMSkelMeshMergeUVTransforms* InSectionUVTransforms = nullptr,
+		const FCMSkelMeshMergeOptions& InOptions = FCMSkelMeshMergeOptions()
 		);
 
 	/**
@@ -138,6 +251,26 @@ public:
 	 */
 	bool FinalizeMesh();
 
+	/**
+	 * Timings and counters of the last merge.
+	 */
+	const FCMSkelMeshMergeStats& GetMergeStats() const { return MergeStats; }
+
+	/**
+	 * Computes how much memory each stream of 'Mesh' takes (vertices, skin weights, morphs, sockets...).
+	 */
+	static void GetMemoryBreakdown(const USkeletalMesh* Mesh, FCMSkelMeshMemoryBreakdown& OutBreakdown);
+
+	/**
+	 * @return index in the materials of 'Mesh' of the material a render section of one of its LODs is drawn with
+	 */
+	static int32 GetSectionMaterialIndex(const USkeletalMesh* Mesh, int32 LODIdx, int32 SectionIdx);
+
+	/**
+	 * @return the material whose shaders 'Material' draws with: its first ancestor that is a UMaterial or overrides static parameters
+	 */
+	static UMaterialInterface* GetStaticPermutationMaterial(UMaterialInterface* Material);
+
 private:
 	/** Destination merged mesh */
 	USkeletalMesh* MergeMesh;
@@ -170,35 +303,100 @@ private:
 	/** optional array to transform UVs in each source mesh */
 	const FCMSkelMeshMergeUVTransforms* SectionUVTransforms;
 
+	/** optional processing applied to the merged mesh */
+	FCMSkelMeshMergeOptions Options;
+
+	/**
+	* Merge temporaries live on the calling thread's FMemStack and are released
+	* by the FMemMark taken for every generated LOD.
+	*/
+	template<typename ElementType>
+	using TScratchArray = TArray<ElementType, TMemStackAllocator<>>;
+
+	/** Timings and counters of the current merge */
+	FCMSkelMeshMergeStats MergeStats;
+
+	/** bounds of the vertices of the first merged LOD, gathered while copying them */
+	FBox MergedVertexBounds;
+
+	/** Options.bMergeMaterialInstances applies, no part uses the instance index UV channel */
+	bool bMergeMaterialInstances;
+
+	/** instances merged into the section of each parent material, in instance index order */
+	TMap<UMaterialInterface*, TArray<UMaterialInterface*>> MergedMaterialInstances;
+
 	/** Matches the Materials array in the final mesh - used for creating the right number of Material slots. */
 	TArray<int32>	MaterialIds;
 
-	/** keeps track of an existing section that need to be merged with another */
+	/**
+	* keeps track of an existing section that need to be merged with another.
+	* Plain record - the bone remapping and UV transforms are views into storage shared by the whole LOD.
+	*/
 	struct FMergeSectionInfo
 	{
 		/** ptr to source skeletal mesh for this section */
 		const USkeletalMesh* SkelMesh;
 		/** ptr to source section for merging */
 		const FSkelMeshRenderSection* Section;
+		/** index of the source mesh in SrcMeshList */
+		int32 MeshIdx;
 		/** mapping from the original BoneMap for this sections chunk to the new MergedBoneMap */
-		TArray<FBoneIndexType> BoneMapToMergedBoneMap;
-		/** transform from the original UVs */
-		TArray<FTransform> UVTransforms;
+		TArrayView<const FBoneIndexType> BoneMapToMergedBoneMap;
+		/** transform from the original UVs, owned by SectionUVTransforms */
+		TArrayView<const FTransform> UVTransforms;
+		/** index of the section material in MergedMaterialInstances, INDEX_NONE when material instances aren't merged */
+		int32 InstanceIndex;
 
-		FMergeSectionInfo( const USkeletalMesh* InSkelMesh,const FSkelMeshRenderSection* InSection, TArray<FTransform> & InUVTransforms )
+		FMergeSectionInfo( const USkeletalMesh* InSkelMesh, const FSkelMeshRenderSection* InSection, int32 InMeshIdx, TArrayView<const FBoneIndexType> InBoneMapToMergedBoneMap, TArrayView<const FTransform> InUVTransforms, int32 InInstanceIndex = INDEX_NONE )
 			:	SkelMesh(InSkelMesh)
 			,	Section(InSection)
+			,	MeshIdx(InMeshIdx)
+			,	BoneMapToMergedBoneMap(InBoneMapToMergedBoneMap)
 			,	UVTransforms(InUVTransforms)
+			,	InstanceIndex(InInstanceIndex)
 		{}
 	};
 
+	/** where every vertex of the source meshes ended up in the merged LOD */
+	struct FSourceVertexRemap
+	{
+		/** first entry of each source mesh in MergedVertexIndices, plus the total at the end */
+		TScratchArray<int32> MeshOffsets;
+		/** merged vertex index of each source vertex, INDEX_NONE if the vertex was not merged */
+		TScratchArray<int32> MergedVertexIndices;
+		/** false for source vertices simplification collapsed into another vertex, the merged vertex keeps the data of its owners */
+		TScratchArray<bool> OwnsMergedVertex;
+
+		int32& Get( int32 MeshIdx, int32 SrcVertIdx )
+		{
+			return MergedVertexIndices[MeshOffsets[MeshIdx] + SrcVertIdx];
+		}
+
+		int32 Get( int32 MeshIdx, int32 SrcVertIdx ) const
+		{
+			return MergedVertexIndices[MeshOffsets[MeshIdx] + SrcVertIdx];
+		}
+
+		/** @return the merged vertex index of every vertex of a source mesh */
+		TArrayView<const int32> GetMeshRemap( int32 MeshIdx ) const
+		{
+			return TArrayView<const int32>(MergedVertexIndices.GetData() + MeshOffsets[MeshIdx], MeshOffsets[MeshIdx + 1] - MeshOffsets[MeshIdx]);
+		}
+
+		/** @return whether every vertex of a source mesh owns its merged vertex */
+		TArrayView<const bool> GetMeshOwnership( int32 MeshIdx ) const
+		{
+			return TArrayView<const bool>(OwnsMergedVertex.GetData() + MeshOffsets[MeshIdx], MeshOffsets[MeshIdx + 1] - MeshOffsets[MeshIdx]);
+		}
+	};
+
 	/** info needed to create a new merged section */
 	struct FNewSectionInfo
 	{
 		/** array of existing sections to merge */
-		TArray<FMergeSectionInfo> MergeSections;
+		TScratchArray<FMergeSectionInfo> MergeSections;
 		/** merged bonemap */
-		TArray<FBoneIndexType> MergedBoneMap;
+		TScratchArray<FBoneIndexType> MergedBoneMap;
 		/** material for use by this section */
 		UMaterialInterface* Material;
 
@@ -226,10 +424,10 @@ private:
 	* Merge a bonemap with an existing bonemap and keep track of remapping
 	* (a bonemap is a list of indices of bones in the USkeletalMesh::RefSkeleton array)
 	* @param MergedBoneMap - out merged bonemap
-	* @param BoneMapToMergedBoneMap - out of mapping from original bonemap to new merged bonemap 
+	* @param BoneMapToMergedBoneMap - out of mapping from original bonemap to new merged bonemap, appended to
 	* @param BoneMap - input bonemap to merge
 	*/
-	void MergeBoneMap( TArray<FBoneIndexType>& MergedBoneMap, TArray<FBoneIndexType>& BoneMapToMergedBoneMap, const TArray<FBoneIndexType>& BoneMap );
+	void MergeBoneMap( TScratchArray<FBoneIndexType>& MergedBoneMap, TScratchArray<FBoneIndexType>& BoneMapToMergedBoneMap, const TScratchArray<FBoneIndexType>& BoneMap );
 
 	/**
 	* Creates a new LOD model and adds the new merged sections to it. Modifies the MergedMesh.
@@ -241,9 +439,136 @@ private:
 	/**
 	* Generate the list of sections that need to be created along with info needed to merge sections
 	* @param NewSectionArray - out array to populate
+	* @param BoneMapStorage - out storage referenced by the BoneMapToMergedBoneMap of every merge section, must outlive NewSectionArray
+	* @param LODIdx - current LOD to process
+	*/
+	void GenerateNewSectionArray( TScratchArray<FNewSectionInfo>& NewSectionArray, TScratchArray<FBoneIndexType>& BoneMapStorage, int32 LODIdx );
+
+	/**
+	* Builds the duplicated vertices buffer of a new section from all its merge sections in one pass
+	* @param Section - new render section, with its final NumVertices
+	* @param NewSectionInfo - merge sections making up the new section
+	* @param SourceVertexRemap - merged vertex index of every source vertex
+	*/
+	void GenerateDuplicatedVertices( FSkelMeshRenderSection& Section, const FNewSectionInfo& NewSectionInfo, const FSourceVertexRemap& SourceVertexRemap );
+
+	/**
+	* Reorders the triangles of a merged section for vertex cache locality, then its vertices by first use.
+	* The section ranges of the merged buffers are permuted in place.
+	* @param Section - section to optimize
+	* @param NewSectionInfo - merge sections making up the section
+	* @param SourceVertexRemap - updated to point at the reordered vertices
+	*/
+	template<typename VertexDataType>
+	void OptimizeSectionVertexCache( FSkelMeshRenderSection& Section, const FNewSectionInfo& NewSectionInfo, TScratchArray<VertexDataType>& VertexBuffer,
+		TArray<FSkinWeightInfo>& SkinWeightBuffer, TScratchArray<FColor>& ColorBuffer, TArray<uint32>& IndexBuffer, FSourceVertexRemap& SourceVertexRemap );
+
+	/**
+	* Collapses the vertices of the last merged section that match in every attribute, within Options tolerances.
+	* The section must be at the end of the merged buffers, which are compacted in place.
+	* @param Section - section to weld, its vertex and triangle counts are updated
+	* @param NewSectionInfo - merge sections making up the section
+	* @param SourceVertexRemap - updated to point at the welded vertices
+	* @return number of vertices removed
+	*/
+	template<typename VertexDataType>
+	int32 WeldSectionVertices( FSkelMeshRenderSection& Section, const FNewSectionInfo& NewSectionInfo, TScratchArray<VertexDataType>& VertexBuffer,
+		TArray<FSkinWeightInfo>& SkinWeightBuffer, TScratchArray<FColor>& ColorBuffer, TArray<uint32>& IndexBuffer, FSourceVertexRemap& SourceVertexRemap );
+
+	/**
+	* @return true if MeshIdx is one of the outer layers that cover the part of a hide mask
+	*/
+	bool IsOuterLayerOf( const FCMSkelMeshPartHideMask& HideMask, int32 MeshIdx ) const;
+
+	/**
+	* @return true if the part of a hide mask is merged along with at least one of its outer layers
+	*/
+	bool IsHideMaskActive( const FCMSkelMeshPartHideMask& HideMask ) const;
+
+	/**
+	* @return the LOD of a source mesh used to build a merged LOD, the closest one it has when it has fewer LODs
+	*/
+	int32 GetSourceLODIndex( int32 MeshIdx, int32 LODIdx ) const;
+
+	/**
+	* @return the render data of the source mesh LOD used to build a merged LOD
+	*/
+	const FSkeletalMeshLODRenderData& GetSourceLODData( int32 MeshIdx, int32 LODIdx ) const;
+
+	/**
+	* @return max bone influences of the vertices of a merged LOD, 0 when unlimited
+	*/
+	int32 GetMaxBoneInfluences( int32 LODIdx ) const;
+
+	/**
+	* @return vertex format policy of a merged LOD
+	*/
+	ECMVertexFormatPolicy GetVertexFormatPolicy( int32 LODIdx ) const;
+
+	/**
+	* @return true if a merged LOD needs full precision UVs, from the parts it is merged from and its vertex format policy
+	*/
+	bool UseFullPrecisionUVs( int32 LODIdx ) const;
+
+	/**
+	* Gives the material slots of merged material instances a dynamic instance of their parent with the parameter table of the instances
+	*/
+	void CreateInstanceParameterTables();
+
+	/**
+	* @return vertex streams read by the materials of the new sections of a merged LOD, limited by KeepVertexStreams
+	*/
+	FCMSkelMeshVertexStreams GetUsedVertexStreams( const TScratchArray<FNewSectionInfo>& NewSectionArray ) const;
+
+	/**
+	* Sums the weighted deltas of the morph targets of Options.BakedMorphWeights for every source vertex of a merged LOD
 	* @param LODIdx - current LOD to process
+	* @param SourceVertexRemap - gives the range of every source mesh in the output arrays
+	* @param OutPositionDeltas - position delta of every source vertex
+	* @param OutTangentZDeltas - normal delta of every source vertex
+	* @return number of morph targets baked, the output arrays are left empty when none is
+	*/
+	int32 GetBakedMorphDeltas( int32 LODIdx, const FSourceVertexRemap& SourceVertexRemap, TScratchArray<FVector>& OutPositionDeltas, TScratchArray<FVector>& OutTangentZDeltas ) const;
+
+	/**
+	* @return number of merged LODs a part is past its last LOD, 0 when it has its own LOD, follows a mapping table or simplification is off
 	*/
-	void GenerateNewSectionArray( TArray<FNewSectionInfo>& NewSectionArray, int32 LODIdx );
+	int32 GetSimplifySteps( int32 MeshIdx, int32 LODIdx ) const;
+
+	/**
+	* Simplifies the merged sections holding parts past their last LOD in parallel, then compacts the merged buffers.
+	* Vertices of the parts that keep their own LOD are never moved.
+	* @param NewSectionArray - merge sections making up every merged section
+	* @param Sections - merged sections, their ranges are updated
+	* @param LODIdx - current LOD to process
+	* @param SourceVertexRemap - updated to point at the kept vertices
+	* @return number of triangles removed
+	*/
+	template<typename VertexDataType>
+	int32 SimplifySections( TArrayView<const FNewSectionInfo> NewSectionArray, TArray<FSkelMeshRenderSection>& Sections, int32 LODIdx, TScratchArray<VertexDataType>& VertexBuffer,
+		TArray<FSkinWeightInfo>& SkinWeightBuffer, TScratchArray<FColor>& ColorBuffer, TArray<uint32>& IndexBuffer, FSourceVertexRemap& SourceVertexRemap );
+
+	/**
+	* Sets the screen size and hysteresis of a merged LOD from the source LODs the parts switch to at that LOD
+	* @param MergeLODInfo - info of the merged LOD
+	* @param LODIdx - current LOD to process
+	*/
+	void ComputeMergedLODScreenSize( FSkeletalMeshLODInfo& MergeLODInfo, int32 LODIdx ) const;
+
+	/**
+	* Flags the triangles of a merge section that Options.HideMasks hide under outer layers
+	* @param MergeSectionInfo - source section to test
+	* @param LODIdx - current LOD to process
+	* @param OutHiddenTriangles - one entry per triangle of the source section, empty when no mask applies
+	* @return number of hidden triangles
+	*/
+	int32 GetHiddenTriangles( const FMergeSectionInfo& MergeSectionInfo, int32 LODIdx, TScratchArray<bool>& OutHiddenTriangles );
+
+	/**
+	* Flags the vertices of a merge section hidden by a per-vertex hide mask
+	* @param OutHiddenVertices - one entry per vertex of the source section
+	*/
+	void GetHiddenVertices( const FCMSkelMeshPartHideMask& HideMask, const FMergeSectionInfo& MergeSectionInfo, int32 LODIdx, TScratchArray<bool>& OutHiddenVertices ) const;
 
 	/**
 	* (Re)initialize and merge skeletal mesh info from the list of source meshes to the merge mesh
@@ -261,6 +586,22 @@ private:
 	 */
 	static void BuildReferenceSkeleton(const TArray<USkeletalMesh*>& SourceMeshList, FReferenceSkeleton& RefSkeleton, const USkeleton* SkeletonAsset);
 
+	/**
+	 * Removes the bones of 'RefSkeleton' that no source vertex is weighted to, no socket is attached to and
+	 * Options.KeepBones does not list. Ancestors of the remaining bones are kept.
+	 */
+	void PruneUnweightedBones(FReferenceSkeleton& RefSkeleton, const USkeleton* SkeletonAsset);
+
+	/**
+	 * Marks the bones sockets are attached to and the bones listed in Options.KeepBones.
+	 */
+	void GetKeptBones(const FReferenceSkeleton& RefSkeleton, TArrayView<bool> OutKeepBone) const;
+
+	/**
+	 * Rebuilds the active and required bones of a merged LOD from the bones its skin weights actually use.
+	 */
+	void ComputeWeightedLODBones(FSkeletalMeshLODRenderData& LODData, TArrayView<const FSkinWeightInfo> SkinWeights) const;
+
 	/**
 	 * Overrides the 'TargetSkeleton' bone poses with the bone poses specified in the 'PoseOverrides' array.
 	 */
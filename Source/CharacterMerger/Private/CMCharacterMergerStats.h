@@ -0,0 +1,111 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+/*=============================================================================
+	CMCharacterMergerStats.h: Stat group and counters for skeletal mesh merging.
+=============================================================================*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "HAL/LowLevelMemTracker.h"
+
+DECLARE_STATS_GROUP(TEXT("CharacterMerger"), STATGROUP_CharacterMerger, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("DoMerge"), STAT_CharacterMerger_DoMerge, STATGROUP_CharacterMerger, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("MergeSkeleton"), STAT_CharacterMerger_MergeSkeleton, STATGROUP_CharacterMerger, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("FinalizeMesh"), STAT_CharacterMerger_FinalizeMesh, STATGROUP_CharacterMerger, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("BuildReferenceSkeleton"), STAT_CharacterMerger_BuildReferenceSkeleton, STATGROUP_CharacterMerger, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("BuildSockets"), STAT_CharacterMerger_BuildSockets, STATGROUP_CharacterMerger, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("PruneBones"), STAT_CharacterMerger_PruneBones, STATGROUP_CharacterMerger, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("GenerateLODModel"), STAT_CharacterMerger_GenerateLODModel, STATGROUP_CharacterMerger, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("GenerateNewSectionArray"), STAT_CharacterMerger_GenerateNewSectionArray, STATGROUP_CharacterMerger, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("CopyVertices"), STAT_CharacterMerger_CopyVertices, STATGROUP_CharacterMerger, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("RemapIndices"), STAT_CharacterMerger_RemapIndices, STATGROUP_CharacterMerger, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("WeldVertices"), STAT_CharacterMerger_WeldVertices, STATGROUP_CharacterMerger, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("HideTriangles"), STAT_CharacterMerger_HideTriangles, STATGROUP_CharacterMerger, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("OptimizeVertexCache"), STAT_CharacterMerger_OptimizeVertexCache, STATGROUP_CharacterMerger, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Simplify"), STAT_CharacterMerger_Simplify, STATGROUP_CharacterMerger, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("ParseMorphs"), STAT_CharacterMerger_ParseMorphs, STATGROUP_CharacterMerger, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("ProcessMergeMesh"), STAT_CharacterMerger_ProcessMergeMesh, STATGROUP_CharacterMerger, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("InitResources"), STAT_CharacterMerger_InitResources, STATGROUP_CharacterMerger, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("BuildTextureAtlas"), STAT_CharacterMerger_BuildTextureAtlas, STATGROUP_CharacterMerger, );
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Merges"), STAT_CharacterMerger_NumMerges, STATGROUP_CharacterMerger, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Merged Sections"), STAT_CharacterMerger_NumSections, STATGROUP_CharacterMerger, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Merged Vertices"), STAT_CharacterMerger_NumVertices, STATGROUP_CharacterMerger, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Merged Indices"), STAT_CharacterMerger_NumIndices, STATGROUP_CharacterMerger, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Merged Morph Deltas"), STAT_CharacterMerger_NumMorphDeltas, STATGROUP_CharacterMerger, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Welded Vertices"), STAT_CharacterMerger_NumWeldedVertices, STATGROUP_CharacterMerger, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Hidden Triangles"), STAT_CharacterMerger_NumHiddenTriangles, STATGROUP_CharacterMerger, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Simplified Triangles"), STAT_CharacterMerger_NumSimplifiedTriangles, STATGROUP_CharacterMerger, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Pruned Bones"), STAT_CharacterMerger_NumPrunedBones, STATGROUP_CharacterMerger, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Vertex Cache Misses Before"), STAT_CharacterMerger_NumCacheMissesBefore, STATGROUP_CharacterMerger, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Vertex Cache Misses After"), STAT_CharacterMerger_NumCacheMissesAfter, STATGROUP_CharacterMerger, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Merged Bytes"), STAT_CharacterMerger_NumBytes, STATGROUP_CharacterMerger, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Scratch Arena Peak"), STAT_CharacterMerger_ScratchArenaPeak, STATGROUP_CharacterMerger, );
+
+/**
+* Low level memory tracker tags of the merger, registered as project tags by the module.
+* Define CM_LLM_TAG_BASE to move them if the project already uses this range.
+*/
+#ifndef CM_LLM_TAG_BASE
+	#define CM_LLM_TAG_BASE ((int32)ELLMTag::ProjectTagStart + 90)
+#endif
+
+enum class ECMLLMTag : int32
+{
+	/** temporaries freed at the end of a merge */
+	MergeScratch = CM_LLM_TAG_BASE,
+	/** vertex, skin weight, color and index data of merged LODs */
+	MergedLODRenderData,
+	/** morph targets written to merged meshes */
+	MergedMorphTargets,
+};
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+DECLARE_LLM_MEMORY_STAT_EXTERN(TEXT("CM Merge Scratch"), STAT_CharacterMergerLLM_MergeScratch, STATGROUP_LLMFULL, );
+DECLARE_LLM_MEMORY_STAT_EXTERN(TEXT("CM Merged LOD Render Data"), STAT_CharacterMergerLLM_MergedLODRenderData, STATGROUP_LLMFULL, );
+DECLARE_LLM_MEMORY_STAT_EXTERN(TEXT("CM Merged Morph Targets"), STAT_CharacterMergerLLM_MergedMorphTargets, STATGROUP_LLMFULL, );
+DECLARE_LLM_MEMORY_STAT_EXTERN(TEXT("CharacterMerger"), STAT_CharacterMergerLLM_Summary, STATGROUP_LLM, );
+
+/** Registers the merger tags with the low level memory tracker */
+void RegisterCharacterMergerLLMTags();
+#endif
+
+#define CM_LLM_SCOPE(Tag) LLM_SCOPE((ELLMTag)ECMLLMTag::Tag)
+
+/**
+* Cycle counter scope that still shows up in Unreal Insights when stats are compiled out.
+*/
+#if STATS
+	#define CM_SCOPE_CYCLE_COUNTER(Stat) SCOPE_CYCLE_COUNTER(Stat)
+#else
+	#define CM_SCOPE_CYCLE_COUNTER(Stat) TRACE_CPUPROFILER_EVENT_SCOPE(Stat)
+#endif
+
+/**
+* Accumulates the wall time of the enclosing scope into a merge phase slot.
+*/
+struct FCMScopedMergePhaseTimer
+{
+	FCMScopedMergePhaseTimer(double& InAccumulator)
+		:	Accumulator(InAccumulator)
+		,	StartTime(FPlatformTime::Seconds())
+	{}
+
+	~FCMScopedMergePhaseTimer()
+	{
+		Accumulator += FPlatformTime::Seconds() - StartTime;
+	}
+
+private:
+	double& Accumulator;
+	double StartTime;
+};
+
+/** Times a merge phase both in the stat system and in the merger's own FCMSkelMeshMergeStats. */
+#define CM_SCOPE_MERGE_PHASE(Stat, Phase) \
+	CM_SCOPE_CYCLE_COUNTER(Stat); \
+	FCMScopedMergePhaseTimer ANONYMOUS_VARIABLE(MergePhaseTimer)(MergeStats.PhaseSeconds[(int32)ECMMergePhase::Phase])
@@ -0,0 +1,609 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CMMeshOptimization.h"
+
+namespace CMMeshOptimization
+{
+	/** Max number of cells a single triangle is added to, larger triangles are clamped to their first cells */
+	static const int32 MaxCellsPerTriangle = 512;
+
+	FTriangleCoverageGrid::FTriangleCoverageGrid(float InCellSize, int32 NumTrianglesHint)
+		:	InvCellSize(1.f / FMath::Max(InCellSize, KINDA_SMALL_NUMBER))
+		,	BucketMask(FMath::RoundUpToPowerOfTwo(FMath::Max(NumTrianglesHint * 4, 64)) - 1)
+	{
+		Vertices.Reserve(NumTrianglesHint * 3);
+		Entries.Reserve(NumTrianglesHint * 2);
+		BucketHeads.Init(INDEX_NONE, BucketMask + 1);
+	}
+
+	FIntVector FTriangleCoverageGrid::GetCell(const FVector& Position) const
+	{
+		return FIntVector(FMath::FloorToInt(Position.X * InvCellSize), FMath::FloorToInt(Position.Y * InvCellSize), FMath::FloorToInt(Position.Z * InvCellSize));
+	}
+
+	void FTriangleCoverageGrid::AddTriangle(const FVector& A, const FVector& B, const FVector& C)
+	{
+		const int32 TriangleIdx = Vertices.Num() / 3;
+		Vertices.Add(A);
+		Vertices.Add(B);
+		Vertices.Add(C);
+
+		const FIntVector MinCell = GetCell(A.ComponentMin(B).ComponentMin(C));
+		const FIntVector MaxCell = GetCell(A.ComponentMax(B).ComponentMax(C));
+
+		int32 NumCells = 0;
+		for (int32 Z = MinCell.Z; Z <= MaxCell.Z; Z++)
+		{
+			for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+			{
+				for (int32 X = MinCell.X; X <= MaxCell.X && NumCells < MaxCellsPerTriangle; X++, NumCells++)
+				{
+					const FIntVector Cell(X, Y, Z);
+					const uint32 Bucket = HashCell(Cell) & BucketMask;
+					Entries.Add({ Cell, TriangleIdx, BucketHeads[Bucket] });
+					BucketHeads[Bucket] = Entries.Num() - 1;
+				}
+			}
+		}
+	}
+
+	/** Two sided Moller-Trumbore ray triangle test */
+	static bool RayIntersectsTriangle(const FVector& Start, const FVector& Direction, float MaxDistance, const FVector& A, const FVector& B, const FVector& C)
+	{
+		const FVector EdgeAB = B - A;
+		const FVector EdgeAC = C - A;
+		const FVector P = FVector::CrossProduct(Direction, EdgeAC);
+		const float Determinant = FVector::DotProduct(EdgeAB, P);
+		if (FMath::Abs(Determinant) < SMALL_NUMBER)
+		{
+			return false;
+		}
+
+		const float InvDeterminant = 1.f / Determinant;
+		const FVector ToStart = Start - A;
+		const float U = FVector::DotProduct(ToStart, P) * InvDeterminant;
+		if (U < 0.f || U > 1.f)
+		{
+			return false;
+		}
+
+		const FVector Q = FVector::CrossProduct(ToStart, EdgeAB);
+		const float V = FVector::DotProduct(Direction, Q) * InvDeterminant;
+		if (V < 0.f || U + V > 1.f)
+		{
+			return false;
+		}
+
+		const float Distance = FVector::DotProduct(EdgeAC, Q) * InvDeterminant;
+		return Distance >= 0.f && Distance <= MaxDistance;
+	}
+
+	bool FTriangleCoverageGrid::RaycastAny(const FVector& Start, const FVector& Direction, float MaxDistance) const
+	{
+		const FVector End = Start + Direction * MaxDistance;
+		const FIntVector MinCell = GetCell(Start.ComponentMin(End));
+		const FIntVector MaxCell = GetCell(Start.ComponentMax(End));
+
+		for (int32 Z = MinCell.Z; Z <= MaxCell.Z; Z++)
+		{
+			for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+			{
+				for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+				{
+					const FIntVector Cell(X, Y, Z);
+					for (int32 EntryIdx = BucketHeads[HashCell(Cell) & BucketMask]; EntryIdx != INDEX_NONE; EntryIdx = Entries[EntryIdx].Next)
+					{
+						const FCellEntry& Entry = Entries[EntryIdx];
+						const int32 VertIdx = Entry.TriangleIdx * 3;
+						if (Entry.Cell == Cell &&
+							RayIntersectsTriangle(Start, Direction, MaxDistance, Vertices[VertIdx], Vertices[VertIdx + 1], Vertices[VertIdx + 2]))
+						{
+							return true;
+						}
+					}
+				}
+			}
+		}
+
+		return false;
+	}
+
+	/** Forsyth score tuning */
+	static const float CacheDecayPower = 1.5f;
+	static const float LastTriangleScore = 0.75f;
+	static const float ValenceBoostScale = 2.f;
+	static const float ValenceBoostPower = 0.5f;
+
+	static float GetVertexScore(int32 CachePosition, int32 NumActiveTriangles)
+	{
+		if (NumActiveTriangles == 0)
+		{
+			// no triangle left to draw
+			return -1.f;
+		}
+
+		float Score = 0.f;
+		if (CachePosition >= 0)
+		{
+			// the last triangle's vertices get a fixed score so the next one doesn't just reuse its edge
+			Score = CachePosition < 3
+				? LastTriangleScore
+				: FMath::Pow(1.f - (float)(CachePosition - 3) / (VertexCacheSize - 3), CacheDecayPower);
+		}
+
+		// favor vertices with few triangles left so they leave the cache for good
+		return Score + ValenceBoostScale * FMath::Pow((float)NumActiveTriangles, -ValenceBoostPower);
+	}
+
+	void OptimizeVertexCache(TArrayView<uint32> Indices, int32 NumVertices)
+	{
+		const int32 NumTriangles = Indices.Num() / 3;
+		if (NumTriangles < 2)
+		{
+			return;
+		}
+
+		// triangles of every vertex, the active ones are kept at the front of each range
+		TArray<int32, TMemStackAllocator<>> NumActiveTriangles;
+		NumActiveTriangles.Init(0, NumVertices);
+		for (int32 Index = 0; Index < NumTriangles * 3; Index++)
+		{
+			NumActiveTriangles[Indices[Index]]++;
+		}
+
+		TArray<int32, TMemStackAllocator<>> VertexTriangleOffsets;
+		VertexTriangleOffsets.SetNumUninitialized(NumVertices);
+		int32 Offset = 0;
+		for (int32 VertIdx = 0; VertIdx < NumVertices; VertIdx++)
+		{
+			VertexTriangleOffsets[VertIdx] = Offset;
+			Offset += NumActiveTriangles[VertIdx];
+		}
+
+		TArray<int32, TMemStackAllocator<>> VertexTriangles;
+		VertexTriangles.SetNumUninitialized(NumTriangles * 3);
+		{
+			TArray<int32, TMemStackAllocator<>> Cursors(VertexTriangleOffsets);
+			for (int32 Index = 0; Index < NumTriangles * 3; Index++)
+			{
+				VertexTriangles[Cursors[Indices[Index]]++] = Index / 3;
+			}
+		}
+
+		TArray<int32, TMemStackAllocator<>> CachePositions;
+		CachePositions.Init(INDEX_NONE, NumVertices);
+		TArray<float, TMemStackAllocator<>> VertexScores;
+		VertexScores.SetNumUninitialized(NumVertices);
+		for (int32 VertIdx = 0; VertIdx < NumVertices; VertIdx++)
+		{
+			VertexScores[VertIdx] = GetVertexScore(INDEX_NONE, NumActiveTriangles[VertIdx]);
+		}
+
+		TArray<bool, TMemStackAllocator<>> TriangleAdded;
+		TriangleAdded.Init(false, NumTriangles);
+
+		int32 BestTriangle = INDEX_NONE;
+		float BestScore = -1.f;
+		for (int32 TriIdx = 0; TriIdx < NumTriangles; TriIdx++)
+		{
+			const float Score = VertexScores[Indices[TriIdx * 3]] + VertexScores[Indices[TriIdx * 3 + 1]] + VertexScores[Indices[TriIdx * 3 + 2]];
+			if (Score > BestScore)
+			{
+				BestScore = Score;
+				BestTriangle = TriIdx;
+			}
+		}
+
+		TArray<uint32, TMemStackAllocator<>> OrderedIndices;
+		OrderedIndices.Reserve(NumTriangles * 3);
+
+		int32 Cache[VertexCacheSize + 3];
+		int32 CacheCount = 0;
+		int32 NextUnaddedTriangle = 0;
+
+		while (OrderedIndices.Num() < NumTriangles * 3)
+		{
+			if (BestTriangle == INDEX_NONE)
+			{
+				// nothing left around the cache, restart from the first triangle not drawn yet
+				while (TriangleAdded[NextUnaddedTriangle])
+				{
+					NextUnaddedTriangle++;
+				}
+				BestTriangle = NextUnaddedTriangle;
+			}
+
+			TriangleAdded[BestTriangle] = true;
+			const uint32* TriangleVertices = &Indices[BestTriangle * 3];
+
+			int32 NewCache[VertexCacheSize + 3];
+			int32 NewCacheCount = 0;
+			for (int32 Corner = 0; Corner < 3; Corner++)
+			{
+				const int32 VertIdx = TriangleVertices[Corner];
+				OrderedIndices.Add(VertIdx);
+				NewCache[NewCacheCount++] = VertIdx;
+
+				// retire the triangle from the vertex active range
+				const int32 First = VertexTriangleOffsets[VertIdx];
+				const int32 Last = First + --NumActiveTriangles[VertIdx];
+				for (int32 Slot = First; Slot <= Last; Slot++)
+				{
+					if (VertexTriangles[Slot] == BestTriangle)
+					{
+						Swap(VertexTriangles[Slot], VertexTriangles[Last]);
+						break;
+					}
+				}
+			}
+
+			// the drawn vertices move to the front of the cache
+			for (int32 CacheIdx = 0; CacheIdx < CacheCount; CacheIdx++)
+			{
+				const int32 VertIdx = Cache[CacheIdx];
+				if (VertIdx != (int32)TriangleVertices[0] && VertIdx != (int32)TriangleVertices[1] && VertIdx != (int32)TriangleVertices[2])
+				{
+					NewCache[NewCacheCount++] = VertIdx;
+				}
+			}
+
+			for (int32 CacheIdx = 0; CacheIdx < NewCacheCount; CacheIdx++)
+			{
+				const int32 VertIdx = NewCache[CacheIdx];
+				CachePositions[VertIdx] = CacheIdx < VertexCacheSize ? CacheIdx : INDEX_NONE;
+				VertexScores[VertIdx] = GetVertexScore(CachePositions[VertIdx], NumActiveTriangles[VertIdx]);
+			}
+
+			// only triangles around the cache changed score
+			BestTriangle = INDEX_NONE;
+			BestScore = -1.f;
+			for (int32 CacheIdx = 0; CacheIdx < NewCacheCount; CacheIdx++)
+			{
+				const int32 VertIdx = NewCache[CacheIdx];
+				const int32 First = VertexTriangleOffsets[VertIdx];
+				for (int32 Slot = First; Slot < First + NumActiveTriangles[VertIdx]; Slot++)
+				{
+					const int32 TriIdx = VertexTriangles[Slot];
+					const float Score = VertexScores[Indices[TriIdx * 3]] + VertexScores[Indices[TriIdx * 3 + 1]] + VertexScores[Indices[TriIdx * 3 + 2]];
+					if (Score > BestScore)
+					{
+						BestScore = Score;
+						BestTriangle = TriIdx;
+					}
+				}
+			}
+
+			CacheCount = FMath::Min(NewCacheCount, VertexCacheSize);
+			FMemory::Memcpy(Cache, NewCache, CacheCount * sizeof(int32));
+		}
+
+		FMemory::Memcpy(Indices.GetData(), OrderedIndices.GetData(), OrderedIndices.Num() * sizeof(uint32));
+	}
+
+	void ReorderVerticesByFirstUse(TArrayView<uint32> Indices, int32 NumVertices, TArray<int32, TMemStackAllocator<>>& OutOldToNew)
+	{
+		OutOldToNew.Reset();
+		OutOldToNew.Init(INDEX_NONE, NumVertices);
+
+		int32 NextVertex = 0;
+		for (uint32& Index : Indices)
+		{
+			int32& NewIndex = OutOldToNew[Index];
+			if (NewIndex == INDEX_NONE)
+			{
+				NewIndex = NextVertex++;
+			}
+			Index = NewIndex;
+		}
+
+		for (int32& NewIndex : OutOldToNew)
+		{
+			if (NewIndex == INDEX_NONE)
+			{
+				NewIndex = NextVertex++;
+			}
+		}
+	}
+
+	int32 CountVertexCacheMisses(TArrayView<const uint32> Indices, int32 NumVertices)
+	{
+		// a vertex is cached while fewer than VertexCacheSize misses happened since it was loaded
+		TArray<int32, TMemStackAllocator<>> LoadTimes;
+		LoadTimes.Init(MIN_int32 / 2, NumVertices);
+
+		int32 NumMisses = 0;
+		for (uint32 Index : Indices)
+		{
+			if (NumMisses - LoadTimes[Index] >= VertexCacheSize)
+			{
+				LoadTimes[Index] = NumMisses++;
+			}
+		}
+		return NumMisses;
+	}
+
+	/** Symmetric 4x4 quadric measuring the mean squared distance of a point to a set of planes */
+	struct FQuadric
+	{
+		double XX, XY, XZ, XW, YY, YZ, YW, ZZ, ZW, WW;
+		double NumPlanes;
+
+		void AddPlane(const FVector& Normal, float Distance)
+		{
+			XX += Normal.X * Normal.X;	XY += Normal.X * Normal.Y;	XZ += Normal.X * Normal.Z;	XW += Normal.X * Distance;
+			YY += Normal.Y * Normal.Y;	YZ += Normal.Y * Normal.Z;	YW += Normal.Y * Distance;
+			ZZ += Normal.Z * Normal.Z;	ZW += Normal.Z * Distance;
+			WW += Distance * Distance;
+			NumPlanes += 1.0;
+		}
+
+		void Add(const FQuadric& Other)
+		{
+			XX += Other.XX;	XY += Other.XY;	XZ += Other.XZ;	XW += Other.XW;
+			YY += Other.YY;	YZ += Other.YZ;	YW += Other.YW;
+			ZZ += Other.ZZ;	ZW += Other.ZW;
+			WW += Other.WW;
+			NumPlanes += Other.NumPlanes;
+		}
+
+		double Evaluate(const FVector& Position) const
+		{
+			const double X = Position.X, Y = Position.Y, Z = Position.Z;
+			// divided by the plane count, so the error doesn't grow with the planes merged quadrics accumulate
+			const double SumSquaredDistances = XX * X * X + YY * Y * Y + ZZ * Z * Z + WW
+				+ 2.0 * (XY * X * Y + XZ * X * Z + YZ * Y * Z + XW * X + YW * Y + ZW * Z);
+			return NumPlanes > 0.0 ? SumSquaredDistances / NumPlanes : 0.0;
+		}
+	};
+
+	/** Candidate collapse of From into To, stale once either vertex changed since it was queued */
+	struct FEdgeCollapse
+	{
+		double Error;
+		int32 From;
+		int32 To;
+		uint32 FromVersion;
+		uint32 ToVersion;
+
+		bool operator<(const FEdgeCollapse& Other) const
+		{
+			return Error < Other.Error;
+		}
+	};
+
+	int32 SimplifyTriangles(TArrayView<uint32> Indices, TArrayView<const FVector> Positions, int32 TargetNumTriangles, float MaxError, TFunctionRef<bool(int32, int32)> CanCollapse, TArrayView<int32> OutRemap)
+	{
+		const int32 NumVertices = Positions.Num();
+		const int32 NumTriangles = Indices.Num() / 3;
+		check(OutRemap.Num() == NumVertices);
+
+		for (int32 VertIdx = 0; VertIdx < NumVertices; VertIdx++)
+		{
+			OutRemap[VertIdx] = VertIdx;
+		}
+		if (NumTriangles <= TargetNumTriangles)
+		{
+			return NumTriangles * 3;
+		}
+
+		FMemMark Mark(FMemStack::Get());
+
+		// vertices on open or non-manifold edges, found from the sorted list of undirected edges
+		TArray<bool, TMemStackAllocator<>> Locked;
+		Locked.Init(false, NumVertices);
+		{
+			TArray<uint64, TMemStackAllocator<>> Edges;
+			Edges.SetNumUninitialized(NumTriangles * 3);
+			for (int32 Corner = 0; Corner < NumTriangles * 3; Corner++)
+			{
+				const uint32 Index0 = Indices[Corner];
+				const uint32 Index1 = Indices[Corner - Corner % 3 + (Corner + 1) % 3];
+				Edges[Corner] = ((uint64)FMath::Min(Index0, Index1) << 32) | FMath::Max(Index0, Index1);
+			}
+			Edges.Sort();
+
+			for (int32 EdgeIdx = 0; EdgeIdx < Edges.Num();)
+			{
+				int32 RunEnd = EdgeIdx + 1;
+				while (RunEnd < Edges.Num() && Edges[RunEnd] == Edges[EdgeIdx])
+				{
+					RunEnd++;
+				}
+				if (RunEnd - EdgeIdx != 2)
+				{
+					Locked[(int32)(Edges[EdgeIdx] >> 32)] = true;
+					Locked[(int32)(Edges[EdgeIdx] & MAX_uint32)] = true;
+				}
+				EdgeIdx = RunEnd;
+			}
+		}
+
+		// plane quadric of every vertex
+		TArray<FQuadric, TMemStackAllocator<>> Quadrics;
+		Quadrics.AddZeroed(NumVertices);
+		for (int32 TriangleIdx = 0; TriangleIdx < NumTriangles; TriangleIdx++)
+		{
+			const FVector& A = Positions[Indices[TriangleIdx * 3 + 0]];
+			const FVector& B = Positions[Indices[TriangleIdx * 3 + 1]];
+			const FVector& C = Positions[Indices[TriangleIdx * 3 + 2]];
+			const FVector Normal = FVector::CrossProduct(B - A, C - A).GetSafeNormal();
+			const float Distance = -FVector::DotProduct(Normal, A);
+			for (int32 Corner = 0; Corner < 3; Corner++)
+			{
+				Quadrics[Indices[TriangleIdx * 3 + Corner]].AddPlane(Normal, Distance);
+			}
+		}
+
+		// triangle corners of every vertex as linked lists, so the corners of a collapsed vertex are spliced in one step
+		TArray<int32, TMemStackAllocator<>> CornerNext;
+		CornerNext.SetNumUninitialized(NumTriangles * 3);
+		TArray<int32, TMemStackAllocator<>> FirstCorner;
+		FirstCorner.Init(INDEX_NONE, NumVertices);
+		TArray<int32, TMemStackAllocator<>> LastCorner;
+		LastCorner.Init(INDEX_NONE, NumVertices);
+		for (int32 Corner = NumTriangles * 3 - 1; Corner >= 0; Corner--)
+		{
+			const uint32 VertIdx = Indices[Corner];
+			CornerNext[Corner] = FirstCorner[VertIdx];
+			FirstCorner[VertIdx] = Corner;
+			if (LastCorner[VertIdx] == INDEX_NONE)
+			{
+				LastCorner[VertIdx] = Corner;
+			}
+		}
+
+		TArray<bool, TMemStackAllocator<>> RemovedTriangles;
+		RemovedTriangles.Init(false, NumTriangles);
+		TArray<uint32, TMemStackAllocator<>> Versions;
+		Versions.AddZeroed(NumVertices);
+
+		TArray<FEdgeCollapse, TMemStackAllocator<>> Heap;
+		Heap.Reserve(NumTriangles * 3);
+
+		auto PushCollapse = [&](int32 From, int32 To)
+		{
+			if (!Locked[From] && CanCollapse(From, To))
+			{
+				FQuadric Quadric = Quadrics[From];
+				Quadric.Add(Quadrics[To]);
+				Heap.HeapPush({ Quadric.Evaluate(Positions[To]), From, To, Versions[From], Versions[To] });
+			}
+		};
+
+		for (int32 Corner = 0; Corner < NumTriangles * 3; Corner++)
+		{
+			const int32 Index0 = Indices[Corner];
+			const int32 Index1 = Indices[Corner - Corner % 3 + (Corner + 1) % 3];
+			PushCollapse(Index0, Index1);
+		}
+
+		// moving From onto To must not flip or degenerate the triangles that keep it
+		auto IsCollapseValid = [&](int32 From, int32 To)
+		{
+			bool bSharesTriangle = false;
+			for (int32 Corner = FirstCorner[From]; Corner != INDEX_NONE; Corner = CornerNext[Corner])
+			{
+				const int32 TriangleIdx = Corner / 3;
+				if (RemovedTriangles[TriangleIdx])
+				{
+					continue;
+				}
+
+				const int32 Next = Indices[TriangleIdx * 3 + (Corner + 1) % 3];
+				const int32 Prev = Indices[TriangleIdx * 3 + (Corner + 2) % 3];
+				if (Next == To || Prev == To)
+				{
+					bSharesTriangle = true;
+					continue;
+				}
+
+				const FVector OldNormal = FVector::CrossProduct(Positions[Next] - Positions[From], Positions[Prev] - Positions[From]);
+				const FVector NewNormal = FVector::CrossProduct(Positions[Next] - Positions[To], Positions[Prev] - Positions[To]);
+				if (NewNormal.SizeSquared() < SMALL_NUMBER || FVector::DotProduct(OldNormal, NewNormal) <= 0.f)
+				{
+					return false;
+				}
+			}
+			return bSharesTriangle;
+		};
+
+		const double MaxErrorSquared = FMath::Square((double)MaxError);
+		int32 NumLiveTriangles = NumTriangles;
+		while (Heap.Num() > 0 && NumLiveTriangles > TargetNumTriangles)
+		{
+			FEdgeCollapse Collapse;
+			Heap.HeapPop(Collapse, false);
+
+			const int32 From = Collapse.From;
+			const int32 To = Collapse.To;
+			if (OutRemap[From] != From || OutRemap[To] != To)
+			{
+				continue;
+			}
+
+			// requeue collapses whose vertices changed with their current error
+			if (Collapse.FromVersion != Versions[From] || Collapse.ToVersion != Versions[To])
+			{
+				PushCollapse(From, To);
+				continue;
+			}
+
+			if (Collapse.Error > MaxErrorSquared)
+			{
+				break;
+			}
+
+			if (!IsCollapseValid(From, To))
+			{
+				continue;
+			}
+
+			// triangles with both vertices disappear, the others move to To
+			for (int32 Corner = FirstCorner[From]; Corner != INDEX_NONE; Corner = CornerNext[Corner])
+			{
+				const int32 TriangleIdx = Corner / 3;
+				if (RemovedTriangles[TriangleIdx])
+				{
+					continue;
+				}
+
+				if (Indices[TriangleIdx * 3 + (Corner + 1) % 3] == To || Indices[TriangleIdx * 3 + (Corner + 2) % 3] == To)
+				{
+					RemovedTriangles[TriangleIdx] = true;
+					NumLiveTriangles--;
+				}
+				else
+				{
+					Indices[Corner] = To;
+				}
+			}
+
+			if (FirstCorner[From] != INDEX_NONE)
+			{
+				CornerNext[LastCorner[To]] = FirstCorner[From];
+				LastCorner[To] = LastCorner[From];
+			}
+			Quadrics[To].Add(Quadrics[From]);
+			OutRemap[From] = To;
+			Versions[To]++;
+
+			// queue the collapses around To with its new quadric
+			for (int32 Corner = FirstCorner[To]; Corner != INDEX_NONE; Corner = CornerNext[Corner])
+			{
+				const int32 TriangleIdx = Corner / 3;
+				if (!RemovedTriangles[TriangleIdx])
+				{
+					const int32 Next = Indices[TriangleIdx * 3 + (Corner + 1) % 3];
+					const int32 Prev = Indices[TriangleIdx * 3 + (Corner + 2) % 3];
+					PushCollapse(Next, To);
+					PushCollapse(To, Next);
+					PushCollapse(Prev, To);
+					PushCollapse(To, Prev);
+				}
+			}
+		}
+
+		// every vertex points at the vertex it finally collapsed into
+		for (int32 VertIdx = 0; VertIdx < NumVertices; VertIdx++)
+		{
+			int32 Kept = OutRemap[VertIdx];
+			while (OutRemap[Kept] != Kept)
+			{
+				Kept = OutRemap[Kept];
+			}
+			OutRemap[VertIdx] = Kept;
+		}
+
+		int32 NumKeptIndices = 0;
+		for (int32 TriangleIdx = 0; TriangleIdx < NumTriangles; TriangleIdx++)
+		{
+			if (!RemovedTriangles[TriangleIdx])
+			{
+				Indices[NumKeptIndices++] = Indices[TriangleIdx * 3 + 0];
+				Indices[NumKeptIndices++] = Indices[TriangleIdx * 3 + 1];
+				Indices[NumKeptIndices++] = Indices[TriangleIdx * 3 + 2];
+			}
+		}
+		return NumKeptIndices;
+	}
+}
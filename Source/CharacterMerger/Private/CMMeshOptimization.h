@@ -0,0 +1,173 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+/*=============================================================================
+	CMMeshOptimization.h: Mesh processing passes run on merged LOD data.
+=============================================================================*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/MemStack.h"
+#include "Templates/Function.h"
+
+namespace CMMeshOptimization
+{
+	/** Hash of a spatial hash cell */
+	FORCEINLINE uint32 HashCell(const FIntVector& Cell)
+	{
+		return ((uint32)Cell.X * 73856093u) ^ ((uint32)Cell.Y * 19349663u) ^ ((uint32)Cell.Z * 83492791u);
+	}
+
+	/**
+	* Collapses every vertex into the first earlier vertex it is equivalent to.
+	* Candidates come from a spatial hash with cells of PositionTolerance, so only vertices
+	* closer than PositionTolerance are handed to AreEquivalent.
+	* @param NumVertices - number of vertices to weld
+	* @param GetPosition - callable (int32 VertIdx) -> FVector
+	* @param PositionTolerance - max distance between welded positions
+	* @param AreEquivalent - callable (int32 KeptIdx, int32 VertIdx) -> bool comparing every other attribute
+	* @param OutRemap - index of the vertex each vertex collapses into, the vertex itself when it is kept
+	* @return number of collapsed vertices
+	*/
+	template<typename GetPositionType, typename AreEquivalentType, typename RemapAllocatorType>
+	int32 FindWeldedVertices(int32 NumVertices, GetPositionType GetPosition, float PositionTolerance, AreEquivalentType AreEquivalent, TArray<int32, RemapAllocatorType>& OutRemap)
+	{
+		OutRemap.SetNumUninitialized(NumVertices);
+		if (NumVertices == 0)
+		{
+			return 0;
+		}
+
+		const float InvCellSize = 1.f / FMath::Max(PositionTolerance, KINDA_SMALL_NUMBER);
+		const float ToleranceSquared = FMath::Square(PositionTolerance);
+
+		// chained hash of the kept vertices, allocated from the scratch arena
+		const uint32 BucketMask = FMath::RoundUpToPowerOfTwo(FMath::Max(NumVertices * 2, 16)) - 1;
+		TArray<int32, TMemStackAllocator<>> BucketHeads;
+		BucketHeads.Init(INDEX_NONE, BucketMask + 1);
+		TArray<int32, TMemStackAllocator<>> NextInBucket;
+		NextInBucket.SetNumUninitialized(NumVertices);
+		TArray<FIntVector, TMemStackAllocator<>> Cells;
+		Cells.SetNumUninitialized(NumVertices);
+
+		int32 NumWelded = 0;
+		for (int32 VertIdx = 0; VertIdx < NumVertices; VertIdx++)
+		{
+			const FVector Position = GetPosition(VertIdx);
+			const FIntVector Cell(FMath::FloorToInt(Position.X * InvCellSize), FMath::FloorToInt(Position.Y * InvCellSize), FMath::FloorToInt(Position.Z * InvCellSize));
+			Cells[VertIdx] = Cell;
+
+			// look for an equivalent kept vertex in the surrounding cells
+			int32 KeptIdx = INDEX_NONE;
+			for (int32 Neighbor = 0; Neighbor < 27 && KeptIdx == INDEX_NONE; Neighbor++)
+			{
+				const FIntVector NeighborCell = Cell + FIntVector(Neighbor % 3 - 1, (Neighbor / 3) % 3 - 1, Neighbor / 9 - 1);
+				for (int32 OtherIdx = BucketHeads[HashCell(NeighborCell) & BucketMask]; OtherIdx != INDEX_NONE; OtherIdx = NextInBucket[OtherIdx])
+				{
+					if (Cells[OtherIdx] == NeighborCell &&
+						FVector::DistSquared(GetPosition(OtherIdx), Position) <= ToleranceSquared &&
+						AreEquivalent(OtherIdx, VertIdx))
+					{
+						KeptIdx = OtherIdx;
+						break;
+					}
+				}
+			}
+
+			if (KeptIdx != INDEX_NONE)
+			{
+				OutRemap[VertIdx] = KeptIdx;
+				NumWelded++;
+			}
+			else
+			{
+				OutRemap[VertIdx] = VertIdx;
+				const uint32 Bucket = HashCell(Cell) & BucketMask;
+				NextInBucket[VertIdx] = BucketHeads[Bucket];
+				BucketHeads[Bucket] = VertIdx;
+			}
+		}
+
+		return NumWelded;
+	}
+
+	/** Size of the post-transform vertex cache triangles are ordered for and ACMR is measured with */
+	static constexpr int32 VertexCacheSize = 32;
+
+	/**
+	* Reorders triangles for post-transform vertex cache locality (Forsyth's linear speed algorithm).
+	* @param Indices - triangle list with indices in [0, NumVertices), reordered in place
+	* @param NumVertices - number of vertices referenced by Indices
+	*/
+	void OptimizeVertexCache(TArrayView<uint32> Indices, int32 NumVertices);
+
+	/**
+	* Renumbers vertices in the order the triangle list first uses them, unreferenced vertices go last.
+	* @param Indices - triangle list with indices in [0, NumVertices), remapped in place
+	* @param OutOldToNew - new index of every vertex
+	*/
+	void ReorderVerticesByFirstUse(TArrayView<uint32> Indices, int32 NumVertices, TArray<int32, TMemStackAllocator<>>& OutOldToNew);
+
+	/**
+	* @return number of vertex cache misses of a triangle list with a FIFO cache of VertexCacheSize entries
+	*/
+	int32 CountVertexCacheMisses(TArrayView<const uint32> Indices, int32 NumVertices);
+
+	/**
+	* Simplifies a triangle list by collapsing edges in increasing quadric error order (Garland-Heckbert).
+	* Every vertex collapses into one of its neighbours, so the kept vertices keep all their attributes.
+	* Vertices on open or non-manifold edges are locked, which keeps section boundaries and attribute seams
+	* (where vertices are split) in place.
+	* @param Indices - triangle list with indices in [0, Positions.Num()), the kept triangles are moved to its start
+	* @param Positions - vertex positions
+	* @param TargetNumTriangles - collapses stop once this many triangles remain
+	* @param MaxError - collapses stop once the root mean square distance of a collapsed vertex to its original planes exceeds this
+	* @param CanCollapse - callable (int32 From, int32 To) -> bool, false for vertices that must not move into another one
+	* @param OutRemap - one entry per vertex, the vertex it collapsed into or the vertex itself when it is kept
+	* @return number of indices kept
+	*/
+	int32 SimplifyTriangles(TArrayView<uint32> Indices, TArrayView<const FVector> Positions, int32 TargetNumTriangles, float MaxError, TFunctionRef<bool(int32, int32)> CanCollapse, TArrayView<int32> OutRemap);
+
+	/**
+	* Uniform grid over a triangle soup answering short ray queries,
+	* used to find the geometry of inner parts covered by outer layers.
+	* All data lives on the calling thread's FMemStack.
+	*/
+	class FTriangleCoverageGrid
+	{
+	public:
+		/**
+		* @param InCellSize - edge length of a cell, ideally close to the query distance
+		* @param NumTrianglesHint - expected number of triangles
+		*/
+		FTriangleCoverageGrid(float InCellSize, int32 NumTrianglesHint);
+
+		/** Adds a triangle to every cell its bounds overlap */
+		void AddTriangle(const FVector& A, const FVector& B, const FVector& C);
+
+		/** @return true if the ray from Start along the normalized Direction hits a triangle within MaxDistance */
+		bool RaycastAny(const FVector& Start, const FVector& Direction, float MaxDistance) const;
+
+		bool IsEmpty() const
+		{
+			return Vertices.Num() == 0;
+		}
+
+	private:
+		struct FCellEntry
+		{
+			FIntVector Cell;
+			int32 TriangleIdx;
+			int32 Next;
+		};
+
+		FIntVector GetCell(const FVector& Position) const;
+
+		float InvCellSize;
+		uint32 BucketMask;
+		/** three vertices per triangle */
+		TArray<FVector, TMemStackAllocator<>> Vertices;
+		TArray<FCellEntry, TMemStackAllocator<>> Entries;
+		TArray<int32, TMemStackAllocator<>> BucketHeads;
+	};
+}
@@ -0,0 +1,532 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CMTextureAtlas.h"
+#include "CharacterMerger.h"
+#include "CMCharacterMerger.h"
+#include "CMCharacterMergerStats.h"
+#include "Async/ParallelFor.h"
+#include "Engine/SkeletalMesh.h"
+#include "Engine/Texture2D.h"
+#include "Materials/Material.h"
+#include "Materials/MaterialInstanceDynamic.h"
+#include "Rendering/SkeletalMeshRenderData.h"
+#include "Rendering/SkeletalMeshLODRenderData.h"
+
+namespace CMTextureAtlas
+{
+	/** UVs further outside [0, 1] than this are tiled and can't be moved into an atlas */
+	static const float UVRangeTolerance = 1.e-3f;
+
+	/** Top mip of a texture as BGRA8 pixels */
+	struct FTexturePixels
+	{
+		TArray<FColor> Pixels;
+		int32 SizeX = 0;
+		int32 SizeY = 0;
+
+		/** Bilinear sample clamped to the edges */
+		FColor Sample(float U, float V) const
+		{
+			const float X = FMath::Clamp(U * SizeX - 0.5f, 0.f, (float)(SizeX - 1));
+			const float Y = FMath::Clamp(V * SizeY - 0.5f, 0.f, (float)(SizeY - 1));
+			const int32 X0 = FMath::FloorToInt(X);
+			const int32 Y0 = FMath::FloorToInt(Y);
+			const int32 X1 = FMath::Min(X0 + 1, SizeX - 1);
+			const int32 Y1 = FMath::Min(Y0 + 1, SizeY - 1);
+			const float FracX = X - X0;
+			const float FracY = Y - Y0;
+
+			const FColor& C00 = Pixels[Y0 * SizeX + X0];
+			const FColor& C10 = Pixels[Y0 * SizeX + X1];
+			const FColor& C01 = Pixels[Y1 * SizeX + X0];
+			const FColor& C11 = Pixels[Y1 * SizeX + X1];
+			auto Filter = [FracX, FracY](uint8 A, uint8 B, uint8 C, uint8 D)
+			{
+				return (uint8)FMath::RoundToInt(FMath::BiLerp((float)A, (float)B, (float)C, (float)D, FracX, FracY));
+			};
+			return FColor(
+				Filter(C00.R, C10.R, C01.R, C11.R),
+				Filter(C00.G, C10.G, C01.G, C11.G),
+				Filter(C00.B, C10.B, C01.B, C11.B),
+				Filter(C00.A, C10.A, C01.A, C11.A));
+		}
+	};
+
+	/** Converts BGRA8 or G8 texels to pixels */
+	static void CopyPixels(const uint8* Data, bool bGrayscale, FTexturePixels& OutPixels)
+	{
+		const int32 NumPixels = OutPixels.SizeX * OutPixels.SizeY;
+		OutPixels.Pixels.SetNumUninitialized(NumPixels);
+		if (bGrayscale)
+		{
+			for (int32 PixelIdx = 0; PixelIdx < NumPixels; PixelIdx++)
+			{
+				OutPixels.Pixels[PixelIdx] = FColor(Data[PixelIdx], Data[PixelIdx], Data[PixelIdx], 255);
+			}
+		}
+		else
+		{
+			// FColor has the BGRA8 memory layout
+			FMemory::Memcpy(OutPixels.Pixels.GetData(), Data, NumPixels * sizeof(FColor));
+		}
+	}
+
+	/**
+	* Reads the top mip of a texture, from the source art when the editor has it, so headless editor builds can pack compressed textures.
+	* @return false if the texture has no uncompressed BGRA8 or G8 data
+	*/
+	static bool ReadTexturePixels(UTexture2D* Texture, FTexturePixels& OutPixels)
+	{
+#if WITH_EDITORONLY_DATA
+		const ETextureSourceFormat SourceFormat = Texture->Source.IsValid() ? Texture->Source.GetFormat() : TSF_Invalid;
+		if (SourceFormat == TSF_BGRA8 || SourceFormat == TSF_G8)
+		{
+			TArray64<uint8> MipData;
+			if (Texture->Source.GetMipData(MipData, 0))
+			{
+				OutPixels.SizeX = Texture->Source.GetSizeX();
+				OutPixels.SizeY = Texture->Source.GetSizeY();
+				CopyPixels(MipData.GetData(), SourceFormat == TSF_G8, OutPixels);
+				return true;
+			}
+		}
+#endif
+
+		FTexturePlatformData* PlatformData = Texture->PlatformData;
+		if (PlatformData == nullptr || PlatformData->Mips.Num() == 0 ||
+			(PlatformData->PixelFormat != PF_B8G8R8A8 && PlatformData->PixelFormat != PF_G8))
+		{
+			return false;
+		}
+
+		FTexture2DMipMap& Mip = PlatformData->Mips[0];
+		const uint8* MipData = (const uint8*)Mip.BulkData.LockReadOnly();
+		if (MipData)
+		{
+			OutPixels.SizeX = Mip.SizeX;
+			OutPixels.SizeY = Mip.SizeY;
+			CopyPixels(MipData, PlatformData->PixelFormat == PF_G8, OutPixels);
+		}
+		Mip.BulkData.Unlock();
+		return MipData != nullptr;
+	}
+
+	/** Part packed into the atlases of a material */
+	struct FAtlasPart
+	{
+		int32 MeshIdx = INDEX_NONE;
+		/** texture of each atlas texture parameter */
+		TArray<UTexture2D*> Textures;
+		/** size of the part in the atlas at full scale, the largest of its textures */
+		FIntPoint FullSize = FIntPoint::ZeroValue;
+		/** position of the padded rectangle in the atlas and size without padding */
+		FIntPoint Position = FIntPoint::ZeroValue;
+		FIntPoint Size = FIntPoint::ZeroValue;
+	};
+
+	/** Parts whose materials draw with the same shaders and the same parameter values, apart from the atlas textures */
+	struct FAtlasGroup
+	{
+		/** material of the first part, parent of the atlas material instance */
+		UMaterialInterface* Material = nullptr;
+		/** material whose shaders every part draws with, see FCMSkeletalMeshMerge::GetStaticPermutationMaterial */
+		UMaterialInterface* PermutationMaterial = nullptr;
+		TArray<FAtlasPart> Parts;
+	};
+
+	/**
+	* Compares the scalar, vector and texture parameter values of two materials drawing with the same shaders.
+	* The atlas texture parameters are left out, the atlas replaces them.
+	*/
+	static bool HasSameParameterValues(const UMaterialInterface* A, const UMaterialInterface* B, const FCMTextureAtlasOptions& Options)
+	{
+		if (A == B)
+		{
+			return true;
+		}
+
+		TArray<FMaterialParameterInfo> ParameterInfos;
+		TArray<FGuid> ParameterIds;
+		A->GetAllScalarParameterInfo(ParameterInfos, ParameterIds);
+		for (const FMaterialParameterInfo& ParameterInfo : ParameterInfos)
+		{
+			float ValueA = 0.f;
+			float ValueB = 0.f;
+			if (A->GetScalarParameterValue(ParameterInfo, ValueA) != B->GetScalarParameterValue(ParameterInfo, ValueB) || ValueA != ValueB)
+			{
+				return false;
+			}
+		}
+
+		ParameterInfos.Reset();
+		ParameterIds.Reset();
+		A->GetAllVectorParameterInfo(ParameterInfos, ParameterIds);
+		for (const FMaterialParameterInfo& ParameterInfo : ParameterInfos)
+		{
+			FLinearColor ValueA = FLinearColor::Black;
+			FLinearColor ValueB = FLinearColor::Black;
+			if (A->GetVectorParameterValue(ParameterInfo, ValueA) != B->GetVectorParameterValue(ParameterInfo, ValueB) || ValueA != ValueB)
+			{
+				return false;
+			}
+		}
+
+		ParameterInfos.Reset();
+		ParameterIds.Reset();
+		A->GetAllTextureParameterInfo(ParameterInfos, ParameterIds);
+		for (const FMaterialParameterInfo& ParameterInfo : ParameterInfos)
+		{
+			if (ParameterInfo.Association == GlobalParameter && Options.TextureParameters.Contains(ParameterInfo.Name))
+			{
+				continue;
+			}
+
+			UTexture* ValueA = nullptr;
+			UTexture* ValueB = nullptr;
+			if (A->GetTextureParameterValue(ParameterInfo, ValueA) != B->GetTextureParameterValue(ParameterInfo, ValueB) || ValueA != ValueB)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	* Finds the textures a part draws with for every texture parameter.
+	* @return the material every section of the part draws with (up to its atlas texture values), null if the part can't go into an atlas
+	*/
+	static UMaterialInterface* GetAtlasMaterial(USkeletalMesh* Mesh, const FCMTextureAtlasOptions& Options, TArray<UTexture2D*>& OutTextures, int32& OutMaxNumSections)
+	{
+		FSkeletalMeshRenderData* Resource = Mesh->GetResourceForRendering();
+		if (Resource == nullptr || Mesh->GetMaterials().Num() == 0)
+		{
+			return nullptr;
+		}
+
+		UMaterialInterface* AtlasMaterial = nullptr;
+		OutMaxNumSections = 0;
+		for (int32 LODIdx = 0; LODIdx < Resource->LODRenderData.Num(); LODIdx++)
+		{
+			const FSkeletalMeshLODRenderData& LODData = Resource->LODRenderData[LODIdx];
+			OutMaxNumSections = FMath::Max(OutMaxNumSections, LODData.RenderSections.Num());
+
+			for (int32 SectionIdx = 0; SectionIdx < LODData.RenderSections.Num(); SectionIdx++)
+			{
+				UMaterialInterface* Material = Mesh->GetMaterials()[FCMSkeletalMeshMerge::GetSectionMaterialIndex(Mesh, LODIdx, SectionIdx)].MaterialInterface;
+				if (Material == nullptr)
+				{
+					return nullptr;
+				}
+
+				if (AtlasMaterial == nullptr)
+				{
+					AtlasMaterial = Material;
+					for (const FName& ParameterName : Options.TextureParameters)
+					{
+						UTexture* Texture = nullptr;
+						Material->GetTextureParameterValue(FMaterialParameterInfo(ParameterName), Texture);
+						UTexture2D* Texture2D = Cast<UTexture2D>(Texture);
+						if (Texture2D == nullptr)
+						{
+							return nullptr;
+						}
+						OutTextures.Add(Texture2D);
+					}
+				}
+				else if (Material != AtlasMaterial)
+				{
+					// another instance is fine as long as it draws the same shader with the same textures and parameter values
+					if (FCMSkeletalMeshMerge::GetStaticPermutationMaterial(Material) != FCMSkeletalMeshMerge::GetStaticPermutationMaterial(AtlasMaterial) ||
+						!HasSameParameterValues(Material, AtlasMaterial, Options))
+					{
+						return nullptr;
+					}
+					for (int32 ParameterIdx = 0; ParameterIdx < Options.TextureParameters.Num(); ParameterIdx++)
+					{
+						UTexture* Texture = nullptr;
+						Material->GetTextureParameterValue(FMaterialParameterInfo(Options.TextureParameters[ParameterIdx]), Texture);
+						if (Texture != OutTextures[ParameterIdx])
+						{
+							return nullptr;
+						}
+					}
+				}
+			}
+
+			// atlas UVs can't tile
+			const FStaticMeshVertexBuffer& VertexBuffer = LODData.StaticVertexBuffers.StaticMeshVertexBuffer;
+			if ((uint32)Options.UVChannel >= VertexBuffer.GetNumTexCoords())
+			{
+				return nullptr;
+			}
+			for (uint32 VertIdx = 0; VertIdx < VertexBuffer.GetNumVertices(); VertIdx++)
+			{
+				const FVector2D UV = VertexBuffer.GetVertexUV(VertIdx, Options.UVChannel);
+				if (UV.GetMin() < -UVRangeTolerance || UV.GetMax() > 1.f + UVRangeTolerance)
+				{
+					return nullptr;
+				}
+			}
+		}
+
+		return AtlasMaterial;
+	}
+
+	/**
+	* Shelf packs padded rectangles, tallest first.
+	* @return false if they don't fit in an AtlasSize square
+	*/
+	static bool PackParts(TArray<FAtlasPart>& Parts, int32 Padding, int32 AtlasSize)
+	{
+		TArray<int32> Order;
+		Order.SetNumUninitialized(Parts.Num());
+		for (int32 PartIdx = 0; PartIdx < Parts.Num(); PartIdx++)
+		{
+			Order[PartIdx] = PartIdx;
+		}
+		Order.Sort([&Parts](int32 A, int32 B) { return Parts[A].Size.Y > Parts[B].Size.Y; });
+
+		int32 ShelfX = 0;
+		int32 ShelfY = 0;
+		int32 ShelfHeight = 0;
+		for (int32 PartIdx : Order)
+		{
+			FAtlasPart& Part = Parts[PartIdx];
+			const FIntPoint PaddedSize = Part.Size + FIntPoint(Padding * 2, Padding * 2);
+			if (ShelfX + PaddedSize.X > AtlasSize)
+			{
+				ShelfY += ShelfHeight;
+				ShelfX = 0;
+				ShelfHeight = 0;
+			}
+			if (PaddedSize.X > AtlasSize || ShelfY + PaddedSize.Y > AtlasSize)
+			{
+				return false;
+			}
+
+			Part.Position = FIntPoint(ShelfX, ShelfY);
+			ShelfX += PaddedSize.X;
+			ShelfHeight = FMath::Max(ShelfHeight, PaddedSize.Y);
+		}
+		return true;
+	}
+
+	/**
+	* Lays the parts out in the smallest square atlas they fit in at full scale, scaling them down by halves when they don't fit in MaxAtlasSize.
+	* @return atlas size, 0 if they can't fit
+	*/
+	static int32 LayoutParts(TArray<FAtlasPart>& Parts, const FCMTextureAtlasOptions& Options)
+	{
+		const int32 MaxAtlasSize = FMath::RoundUpToPowerOfTwo(FMath::Max(Options.MaxAtlasSize, 1));
+		for (int32 ScaleShift = 0; ScaleShift < 16; ScaleShift++)
+		{
+			int64 Area = 0;
+			for (FAtlasPart& Part : Parts)
+			{
+				Part.Size = FIntPoint(FMath::Max(Part.FullSize.X >> ScaleShift, 1), FMath::Max(Part.FullSize.Y >> ScaleShift, 1));
+				Area += (int64)(Part.Size.X + Options.Padding * 2) * (Part.Size.Y + Options.Padding * 2);
+			}
+
+			for (int32 AtlasSize = FMath::RoundUpToPowerOfTwo(FMath::CeilToInt(FMath::Sqrt((double)Area))); AtlasSize <= MaxAtlasSize; AtlasSize *= 2)
+			{
+				if (PackParts(Parts, Options.Padding, AtlasSize))
+				{
+					return AtlasSize;
+				}
+			}
+		}
+		return 0;
+	}
+
+	/** Creates a transient texture with a box filtered mip chain of square power of two pixels */
+	static UTexture2D* CreateAtlasTexture(TArray<FColor>& Pixels, int32 AtlasSize, const UTexture2D* Template)
+	{
+		UTexture2D* Atlas = UTexture2D::CreateTransient(AtlasSize, AtlasSize, PF_B8G8R8A8);
+		if (Atlas == nullptr)
+		{
+			return nullptr;
+		}
+		Atlas->SRGB = Template->SRGB;
+		Atlas->CompressionSettings = Template->CompressionSettings;
+		Atlas->LODGroup = Template->LODGroup;
+
+		Atlas->PlatformData->Mips.Empty();
+		for (int32 MipSize = AtlasSize; MipSize > 0; MipSize /= 2)
+		{
+			if (MipSize < AtlasSize)
+			{
+				// halve the previous mip in place, every texel only reads texels at or after its own index
+				const int32 PrevSize = MipSize * 2;
+				for (int32 Y = 0; Y < MipSize; Y++)
+				{
+					for (int32 X = 0; X < MipSize; X++)
+					{
+						const FColor& C00 = Pixels[(Y * 2) * PrevSize + X * 2];
+						const FColor& C10 = Pixels[(Y * 2) * PrevSize + X * 2 + 1];
+						const FColor& C01 = Pixels[(Y * 2 + 1) * PrevSize + X * 2];
+						const FColor& C11 = Pixels[(Y * 2 + 1) * PrevSize + X * 2 + 1];
+						Pixels[Y * MipSize + X] = FColor(
+							(uint8)((C00.R + C10.R + C01.R + C11.R + 2) / 4),
+							(uint8)((C00.G + C10.G + C01.G + C11.G + 2) / 4),
+							(uint8)((C00.B + C10.B + C01.B + C11.B + 2) / 4),
+							(uint8)((C00.A + C10.A + C01.A + C11.A + 2) / 4));
+					}
+				}
+			}
+
+			FTexture2DMipMap* Mip = new FTexture2DMipMap();
+			Atlas->PlatformData->Mips.Add(Mip);
+			Mip->SizeX = MipSize;
+			Mip->SizeY = MipSize;
+			Mip->BulkData.Lock(LOCK_READ_WRITE);
+			void* MipData = Mip->BulkData.Realloc(MipSize * MipSize * sizeof(FColor));
+			FMemory::Memcpy(MipData, Pixels.GetData(), MipSize * MipSize * sizeof(FColor));
+			Mip->BulkData.Unlock();
+		}
+
+		Atlas->UpdateResource();
+		return Atlas;
+	}
+
+	int32 BuildTextureAtlases(const TArray<USkeletalMesh*>& Parts, const FCMTextureAtlasOptions& Options, UObject* Outer, TArray<FCMSkelMeshMergeSectionMapping>& OutSectionMapping, FCMSkelMeshMergeUVTransforms& OutUVTransforms)
+	{
+		CM_SCOPE_CYCLE_COUNTER(STAT_CharacterMerger_BuildTextureAtlas);
+
+		OutSectionMapping.Reset();
+		OutSectionMapping.SetNum(Parts.Num());
+		OutUVTransforms.UVTransformsPerMesh.Reset();
+		OutUVTransforms.UVTransformsPerMesh.SetNum(Parts.Num());
+		if (Options.TextureParameters.Num() == 0)
+		{
+			return 0;
+		}
+
+		// group the packable parts by the shaders and parameter values they draw with, the parts of a group can share a material instance
+		TArray<FAtlasGroup> Groups;
+		TArray<int32> NumSectionsPerMesh;
+		NumSectionsPerMesh.SetNumZeroed(Parts.Num());
+		for (int32 MeshIdx = 0; MeshIdx < Parts.Num(); MeshIdx++)
+		{
+			if (Parts[MeshIdx] == nullptr)
+			{
+				continue;
+			}
+
+			FAtlasPart Part;
+			Part.MeshIdx = MeshIdx;
+			UMaterialInterface* Material = GetAtlasMaterial(Parts[MeshIdx], Options, Part.Textures, NumSectionsPerMesh[MeshIdx]);
+			if (Material == nullptr)
+			{
+				continue;
+			}
+
+			UMaterialInterface* PermutationMaterial = FCMSkeletalMeshMerge::GetStaticPermutationMaterial(Material);
+			FAtlasGroup* Group = Groups.FindByPredicate([PermutationMaterial, Material, &Options](const FAtlasGroup& Other)
+			{
+				return Other.PermutationMaterial == PermutationMaterial && HasSameParameterValues(Other.Material, Material, Options);
+			});
+			if (Group == nullptr)
+			{
+				Group = &Groups.AddDefaulted_GetRef();
+				Group->Material = Material;
+				Group->PermutationMaterial = PermutationMaterial;
+			}
+			Group->Parts.Add(MoveTemp(Part));
+		}
+
+		// parts share the decoded textures
+		TMap<UTexture2D*, FTexturePixels> TexturePixels;
+		int32 NumAtlasedParts = 0;
+		int32 AtlasId = 0;
+		for (FAtlasGroup& Group : Groups)
+		{
+			for (int32 PartIdx = Group.Parts.Num() - 1; PartIdx >= 0; PartIdx--)
+			{
+				FAtlasPart& Part = Group.Parts[PartIdx];
+				for (UTexture2D* Texture : Part.Textures)
+				{
+					FTexturePixels* Pixels = TexturePixels.Find(Texture);
+					if (Pixels == nullptr)
+					{
+						Pixels = &TexturePixels.Add(Texture);
+						ReadTexturePixels(Texture, *Pixels);
+					}
+
+					if (Pixels->Pixels.Num() == 0)
+					{
+						UE_LOG(LogCharacterMerger, Warning, TEXT("Texture %s of %s can't go into an atlas, it needs CPU readable B8G8R8A8 or G8 data"),
+							*Texture->GetName(), *Parts[Part.MeshIdx]->GetName());
+						Part.FullSize = FIntPoint::ZeroValue;
+						break;
+					}
+					Part.FullSize = Part.FullSize.ComponentMax(FIntPoint(Pixels->SizeX, Pixels->SizeY));
+				}
+
+				if (Part.FullSize.X == 0)
+				{
+					Group.Parts.RemoveAt(PartIdx);
+				}
+			}
+
+			// a single part already draws with a single material
+			if (Group.Parts.Num() < 2)
+			{
+				continue;
+			}
+
+			const int32 AtlasSize = LayoutParts(Group.Parts, Options);
+			if (AtlasSize == 0)
+			{
+				UE_LOG(LogCharacterMerger, Warning, TEXT("%d parts of %s don't fit in a %d texture atlas"), Group.Parts.Num(), *Group.Material->GetName(), Options.MaxAtlasSize);
+				continue;
+			}
+
+			UMaterialInstanceDynamic* AtlasMaterial = UMaterialInstanceDynamic::Create(Group.Material, Outer);
+			for (int32 ParameterIdx = 0; ParameterIdx < Options.TextureParameters.Num(); ParameterIdx++)
+			{
+				TArray<FColor> AtlasPixels;
+				AtlasPixels.SetNumZeroed(AtlasSize * AtlasSize);
+
+				// every part fills its own padded rectangle, the padding repeats its edge texels
+				ParallelFor(Group.Parts.Num(), [&](int32 PartIdx)
+				{
+					const FAtlasPart& Part = Group.Parts[PartIdx];
+					const FTexturePixels& Pixels = TexturePixels.FindChecked(Part.Textures[ParameterIdx]);
+					for (int32 Y = 0; Y < Part.Size.Y + Options.Padding * 2; Y++)
+					{
+						const float V = (FMath::Clamp(Y - Options.Padding, 0, Part.Size.Y - 1) + 0.5f) / Part.Size.Y;
+						FColor* Row = AtlasPixels.GetData() + (Part.Position.Y + Y) * AtlasSize + Part.Position.X;
+						for (int32 X = 0; X < Part.Size.X + Options.Padding * 2; X++)
+						{
+							const float U = (FMath::Clamp(X - Options.Padding, 0, Part.Size.X - 1) + 0.5f) / Part.Size.X;
+							Row[X] = Pixels.Sample(U, V);
+						}
+					}
+				});
+
+				UTexture2D* AtlasTexture = CreateAtlasTexture(AtlasPixels, AtlasSize, Group.Parts[0].Textures[ParameterIdx]);
+				AtlasMaterial->SetTextureParameterValue(Options.TextureParameters[ParameterIdx], AtlasTexture);
+			}
+
+			// move the parts to the section of the atlas and their UVs to their rectangle
+			for (const FAtlasPart& Part : Group.Parts)
+			{
+				FCMSkelMeshMergeSectionMapping& SectionMapping = OutSectionMapping[Part.MeshIdx];
+				SectionMapping.SectionIDs.Init(AtlasId, NumSectionsPerMesh[Part.MeshIdx]);
+				SectionMapping.SectionMaterials.Init(AtlasMaterial, NumSectionsPerMesh[Part.MeshIdx]);
+
+				const FVector2D Offset = FVector2D(Part.Position + FIntPoint(Options.Padding, Options.Padding)) / AtlasSize;
+				const FVector2D Scale = FVector2D(Part.Size) / AtlasSize;
+				TArray<FTransform>& UVTransforms = OutUVTransforms.UVTransformsPerMesh[Part.MeshIdx];
+				UVTransforms.Init(FTransform::Identity, Options.UVChannel + 1);
+				UVTransforms[Options.UVChannel] = FTransform(FQuat::Identity, FVector(Offset, 0.f), FVector(Scale, 1.f));
+			}
+
+			UE_LOG(LogCharacterMerger, Verbose, TEXT("Packed %d parts of %s into %dx%d atlases"), Group.Parts.Num(), *Group.Material->GetName(), AtlasSize, AtlasSize);
+			NumAtlasedParts += Group.Parts.Num();
+			AtlasId++;
+		}
+
+		return NumAtlasedParts;
+	}
+}
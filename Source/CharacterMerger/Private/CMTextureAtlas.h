@@ -0,0 +1,36 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+/*=============================================================================
+	CMTextureAtlas.h: Packing of part textures into shared atlases before a merge.
+=============================================================================*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CharacterMergerTypes.h"
+
+class UObject;
+class USkeletalMesh;
+struct FCMSkelMeshMergeSectionMapping;
+struct FCMSkelMeshMergeUVTransforms;
+
+namespace CMTextureAtlas
+{
+	/**
+	* Packs the textures of parts whose materials share a parent material and its static parameters (static switches,
+	* component masks) into one atlas per texture parameter, and creates a material instance of the first part's material
+	* sampling the atlases.
+	* The material instance carries the first part's parameter values, so parts are only packed together when every scalar,
+	* vector and texture parameter other than Options.TextureParameters has the same value in their materials.
+	* A part is only packed when every section of every LOD draws the same textures and parameter values, its UVs stay in [0, 1] and
+	* its textures have CPU readable BGRA8 or G8 data (the texture source in the editor, the platform data otherwise).
+	* Parents with a single packable part are left alone.
+	* @param Parts - source meshes of the merge
+	* @param Options - atlas settings
+	* @param Outer - outer of the created material instances
+	* @param OutSectionMapping - one entry per part, the packed parts map every section to the section of their atlas
+	* @param OutUVTransforms - one entry per part, the packed parts move Options.UVChannel to their atlas rectangle
+	* @return number of parts packed into an atlas
+	*/
+	int32 BuildTextureAtlases(const TArray<USkeletalMesh*>& Parts, const FCMTextureAtlasOptions& Options, UObject* Outer, TArray<FCMSkelMeshMergeSectionMapping>& OutSectionMapping, FCMSkelMeshMergeUVTransforms& OutUVTransforms);
+}
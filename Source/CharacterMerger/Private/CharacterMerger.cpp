@@ -1,12 +1,18 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "CharacterMerger.h"
+#include "CMCharacterMergerStats.h"
 
 #define LOCTEXT_NAMESPACE "FCharacterMergerModule"
 
+DEFINE_LOG_CATEGORY(LogCharacterMerger);
+
 void FCharacterMergerModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	RegisterCharacterMergerLLMTags();
+#endif
 }
 
 void FCharacterMergerModule::ShutdownModule()
@@ -1,23 +1,185 @@
 ﻿#include "CharacterMergerLibrary.h"
+#include "CharacterMerger.h"
 #include "CMCharacterMerger.h"
+#include "CMTextureAtlas.h"
+#include "Engine/SkeletalMesh.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/Crc.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
 #include "Rendering/SkeletalMeshRenderData.h"
 
-USkeletalMesh* FCharacterMergerLibrary::MergeRequest(const TArray<USkeletalMesh*>& ComponentsToWeld, UPackage* Package)
+static TAutoConsoleVariable<int32> CVarCharacterMergerHitchReport(
+	TEXT("CharacterMerger.HitchReport"),
+	0,
+	TEXT("Report merges that exceed CharacterMerger.HitchBudgetMs.\n")
+	TEXT(" 0: off (default)\n")
+	TEXT(" 1: log only\n")
+	TEXT(" 2: log and append a CSV line to Saved/CharacterMerger/MergeHitches-<header hash>.csv, a new file whenever the columns change\n")
+	TEXT(" 3: log and append a JSON line to Saved/CharacterMerger/MergeHitches.json"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarCharacterMergerHitchBudgetMs(
+	TEXT("CharacterMerger.HitchBudgetMs"),
+	5.0f,
+	TEXT("Time budget of a single merge in milliseconds, merges taking longer are reported as hitches."),
+	ECVF_Default);
+
+/** Input part names joined with ';' */
+static FString GetPartNames(const TArray<USkeletalMesh*>& Parts)
+{
+	FString PartNames;
+	for (const USkeletalMesh* Part : Parts)
+	{
+		if (!PartNames.IsEmpty())
+		{
+			PartNames += TEXT(";");
+		}
+		PartNames += Part ? Part->GetName() : TEXT("None");
+	}
+	return PartNames;
+}
+
+/** One column of a merge hitch report */
+struct FMergeHitchField
+{
+	FString Name;
+	FString Value;
+	/** quoted in the CSV and JSON reports */
+	bool bString;
+};
+
+/** Every column of a merge hitch report, shared by the log line, the CSV and the JSON reports */
+static TArray<FMergeHitchField> GetMergeHitchFields(const TArray<USkeletalMesh*>& Parts, const FCMSkelMeshMergeStats& Stats, double TotalMs, float BudgetMs)
+{
+	TArray<FMergeHitchField> Fields;
+	auto AddString = [&Fields](const FString& Name, const FString& Value) { Fields.Add({ Name, Value, true }); };
+	auto AddInt = [&Fields](const FString& Name, int64 Value) { Fields.Add({ Name, LexToString(Value), false }); };
+	auto AddFloat = [&Fields](const FString& Name, double Value) { Fields.Add({ Name, FString::Printf(TEXT("%.3f"), Value), false }); };
+
+	AddString(TEXT("Time"), FDateTime::UtcNow().ToIso8601());
+	AddFloat(TEXT("TotalMs"), TotalMs);
+	AddFloat(TEXT("BudgetMs"), BudgetMs);
+	AddString(TEXT("Parts"), GetPartNames(Parts));
+	AddInt(TEXT("LODs"), Stats.NumLODs);
+	AddInt(TEXT("BonesBefore"), Stats.NumRefBonesBeforePruning);
+	AddInt(TEXT("Bones"), Stats.NumRefBones);
+	AddInt(TEXT("ActiveBonesBefore"), Stats.NumActiveBonesBeforePruning);
+	AddInt(TEXT("ActiveBones"), Stats.NumActiveBones);
+	AddInt(TEXT("Sections"), Stats.NumSections);
+	AddInt(TEXT("Vertices"), Stats.NumVertices);
+	AddInt(TEXT("Indices"), Stats.NumIndices);
+	AddInt(TEXT("WeldedVertices"), Stats.NumWeldedVertices);
+	AddInt(TEXT("HiddenTriangles"), Stats.NumHiddenTriangles);
+	AddInt(TEXT("SimplifiedTriangles"), Stats.NumSimplifiedTriangles);
+	AddInt(TEXT("PrunedInfluences"), Stats.NumPrunedInfluences);
+	AddInt(TEXT("SkinWeightBytesSaved"), Stats.NumSkinWeightBytesSaved);
+	AddInt(TEXT("VertexStreamBytesSaved"), Stats.NumVertexStreamBytesSaved);
+	AddFloat(TEXT("ACMRBefore"), Stats.GetACMRBefore());
+	AddFloat(TEXT("ACMRAfter"), Stats.GetACMRAfter());
+	AddInt(TEXT("MorphTargets"), Stats.NumMorphTargets);
+	AddInt(TEXT("MorphDeltas"), Stats.NumMorphDeltas);
+	AddInt(TEXT("PrunedMorphDeltas"), Stats.NumPrunedMorphDeltas);
+	AddInt(TEXT("Bytes"), Stats.NumBytes);
+	for (int32 PhaseIdx = 0; PhaseIdx < (int32)ECMMergePhase::Num; PhaseIdx++)
+	{
+		AddFloat(FString::Printf(TEXT("%sMs"), FCMSkelMeshMergeStats::GetPhaseName((ECMMergePhase)PhaseIdx)), Stats.PhaseSeconds[PhaseIdx] * 1000.0);
+	}
+	return Fields;
+}
+
+/** Logs a slow merge and appends it to the hitch file selected by CharacterMerger.HitchReport */
+static void ReportMergeHitch(const TArray<USkeletalMesh*>& Parts, const FCMSkelMeshMergeStats& Stats, double TotalMs, float BudgetMs, int32 ReportMode)
+{
+	const TArray<FMergeHitchField> Fields = GetMergeHitchFields(Parts, Stats, TotalMs, BudgetMs);
+
+	FString LogLine;
+	for (const FMergeHitchField& Field : Fields)
+	{
+		LogLine += FString::Printf(TEXT(" %s=%s"), *Field.Name, *Field.Value);
+	}
+	UE_LOG(LogCharacterMerger, Warning, TEXT("Merge over budget:%s"), *LogLine);
+
+	if (ReportMode < 2)
+	{
+		return;
+	}
+
+	const bool bJson = ReportMode >= 3;
+	FString Line;
+	FString ReportFile;
+	if (bJson)
+	{
+		for (int32 FieldIdx = 0; FieldIdx < Fields.Num(); FieldIdx++)
+		{
+			const FMergeHitchField& Field = Fields[FieldIdx];
+			const FString Value = Field.bString ? FString::Printf(TEXT("\"%s\""), *Field.Value.ReplaceCharWithEscapedChar()) : Field.Value;
+			Line += FString::Printf(TEXT("%s\"%s\":%s"), FieldIdx > 0 ? TEXT(",") : TEXT("{"), *Field.Name, *Value);
+		}
+		Line += TEXT("}\n");
+		ReportFile = FPaths::ProjectSavedDir() / TEXT("CharacterMerger") / TEXT("MergeHitches.json");
+	}
+	else
+	{
+		// the file is named after its header, so rows are never appended under other columns
+		FString Header;
+		for (int32 FieldIdx = 0; FieldIdx < Fields.Num(); FieldIdx++)
+		{
+			Header += FString::Printf(TEXT("%s%s"), FieldIdx > 0 ? TEXT(",") : TEXT(""), *Fields[FieldIdx].Name);
+		}
+		ReportFile = FPaths::ProjectSavedDir() / TEXT("CharacterMerger") / FString::Printf(TEXT("MergeHitches-%08x.csv"), FCrc::StrCrc32(*Header));
+		if (!FPaths::FileExists(ReportFile))
+		{
+			Line = Header + LINE_TERMINATOR;
+		}
+
+		for (int32 FieldIdx = 0; FieldIdx < Fields.Num(); FieldIdx++)
+		{
+			const FMergeHitchField& Field = Fields[FieldIdx];
+			const FString Value = Field.bString ? FString::Printf(TEXT("\"%s\""), *Field.Value) : Field.Value;
+			Line += FString::Printf(TEXT("%s%s"), FieldIdx > 0 ? TEXT(",") : TEXT(""), *Value);
+		}
+		Line += LINE_TERMINATOR;
+	}
+
+	FFileHelper::SaveStringToFile(Line, *ReportFile, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM, &IFileManager::Get(), FILEWRITE_Append);
+}
+
+USkeletalMesh* FCharacterMergerLibrary::MergeRequest(const TArray<USkeletalMesh*>& ComponentsToWeld, UPackage* Package, const FCMSkelMeshMergeOptions& Options)
 {
 	if (ComponentsToWeld.Num() == 0) return nullptr;
 
+	const double StartTime = FPlatformTime::Seconds();
+
 	USkeletalMesh* CompositeMesh = IsValid(Package) ? NewObject<USkeletalMesh>(Package, NAME_None, RF_Public | RF_Standalone) : NewObject<USkeletalMesh>();
 	CompositeMesh->SetRefSkeleton(ComponentsToWeld[0]->GetSkeleton()->GetReferenceSkeleton());
 	CompositeMesh->SetSkeleton(ComponentsToWeld[0]->GetSkeleton());
 		
 	TArray<FCMSkelMeshMergeSectionMapping> InForceSectionMapping;
-	FCMSkeletalMeshMerge MeshMergeUtil(CompositeMesh, ComponentsToWeld, InForceSectionMapping, 0);
+	FCMSkelMeshMergeUVTransforms UVTransforms;
+	const bool bUseTextureAtlas = Options.bBuildTextureAtlas &&
+		CMTextureAtlas::BuildTextureAtlases(ComponentsToWeld, Options.TextureAtlas, CompositeMesh, InForceSectionMapping, UVTransforms) > 0;
+
+	FCMSkeletalMeshMerge MeshMergeUtil(CompositeMesh, ComponentsToWeld, InForceSectionMapping, 0, EMeshBufferAccess::Default, bUseTextureAtlas ? &UVTransforms : nullptr, Options);
 	if (!MeshMergeUtil.DoMerge())
 	{
 		check(0 && "Something went wrong");
 		return nullptr;
 	}
 
+	const int32 HitchReportMode = CVarCharacterMergerHitchReport.GetValueOnGameThread();
+	if (HitchReportMode > 0)
+	{
+		const double TotalMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+		const float BudgetMs = CVarCharacterMergerHitchBudgetMs.GetValueOnGameThread();
+		if (TotalMs > BudgetMs)
+		{
+			ReportMergeHitch(ComponentsToWeld, MeshMergeUtil.GetMergeStats(), TotalMs, BudgetMs, HitchReportMode);
+		}
+	}
+
 	/*for(int32 It = 0; It < ComponentsToWeld.Num(); It++)
 	{
 		ParseMorphs(ComponentsToWeld[It], CompositeMesh, It);
@@ -31,3 +193,24 @@ USkeletalMesh* FCharacterMergerLibrary::MergeRequest(const TArray<USkeletalMesh*
 	
 	return CompositeMesh;
 }
+
+USkeletalMesh* FCharacterMergerLibrary::BakeSimplifiedLODs(USkeletalMesh* SourceMesh, int32 NumGeneratedLODs, float TriangleRatio, UPackage* Package)
+{
+	if (SourceMesh == nullptr) return nullptr;
+
+	// a merge of a single part that appends simplified copies of its last LOD
+	FCMSkelMeshMergeOptions Options;
+	Options.LODCount = ECMMergedLODCount::MainBody;
+	Options.NumGeneratedLODs = NumGeneratedLODs;
+	Options.bSimplifyReusedLODs = true;
+	Options.SimplifyTriangleRatio = TriangleRatio;
+
+	return MergeRequest({ SourceMesh }, Package, Options);
+}
+
+FCMSkelMeshMemoryBreakdown FCharacterMergerLibrary::GetMergedMeshMemory(const USkeletalMesh* MergedMesh)
+{
+	FCMSkelMeshMemoryBreakdown Breakdown;
+	FCMSkeletalMeshMerge::GetMemoryBreakdown(MergedMesh, Breakdown);
+	return Breakdown;
+}
@@ -1,9 +1,19 @@
 ﻿#pragma once
 
 #include "CoreMinimal.h"
+#include "CharacterMergerTypes.h"
 
 class CHARACTERMERGER_API FCharacterMergerLibrary
 {
 public:
-	static USkeletalMesh* MergeRequest(const TArray<USkeletalMesh*>& ComponentsToWeld, UPackage* Package = nullptr);
+	static USkeletalMesh* MergeRequest(const TArray<USkeletalMesh*>& ComponentsToWeld, UPackage* Package = nullptr, const FCMSkelMeshMergeOptions& Options = FCMSkelMeshMergeOptions());
+
+	/**
+	* Offline counterpart of FCMSkelMeshMergeOptions::bSimplifyReusedLODs: returns a copy of SourceMesh with
+	* NumGeneratedLODs extra LODs, each keeping TriangleRatio of the triangles of the previous one. Save it through Package to prebake it.
+	*/
+	static USkeletalMesh* BakeSimplifiedLODs(USkeletalMesh* SourceMesh, int32 NumGeneratedLODs, float TriangleRatio = 0.5f, UPackage* Package = nullptr);
+
+	/** Returns how much memory each stream (vertices, skin weights, morphs, sockets...) of a merged mesh takes. */
+	static FCMSkelMeshMemoryBreakdown GetMergedMeshMemory(const USkeletalMesh* MergedMesh);
 };
@@ -0,0 +1,277 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UTexture2D;
+
+/**
+* Memory held by each stream of a single merged LOD, in bytes
+*/
+struct FCMSkelMeshLODMemory
+{
+	/** position vertex buffer */
+	int64 Positions = 0;
+	/** tangent basis part of the static mesh vertex buffer */
+	int64 Tangents = 0;
+	/** texture coordinate part of the static mesh vertex buffer */
+	int64 TexCoords = 0;
+	/** vertex color buffer */
+	int64 Colors = 0;
+	/** skin weight buffer (influences and lookup) */
+	int64 SkinWeights = 0;
+	/** index buffer */
+	int64 Indices = 0;
+	/** duplicated vertices buffers of all render sections */
+	int64 DuplicatedVertices = 0;
+
+	int64 GetTotal() const
+	{
+		return Positions + Tangents + TexCoords + Colors + SkinWeights + Indices + DuplicatedVertices;
+	}
+};
+
+/**
+* Per-stream memory breakdown of a merged USkeletalMesh
+*/
+struct FCMSkelMeshMemoryBreakdown
+{
+	/** render data of every LOD */
+	TArray<FCMSkelMeshLODMemory> LODs;
+	/** morph target deltas over all LODs */
+	int64 MorphTargets = 0;
+	/** mesh sockets */
+	int64 Sockets = 0;
+
+	int64 GetTotal() const
+	{
+		int64 Total = MorphTargets + Sockets;
+		for (const FCMSkelMeshLODMemory& LOD : LODs)
+		{
+			Total += LOD.GetTotal();
+		}
+		return Total;
+	}
+};
+
+/**
+* How the triangles of a part hidden under outer layers are found
+*/
+enum class ECMHideMaskMode : uint8
+{
+	/** a vertex color channel of the part marks hidden vertices */
+	VertexColor,
+	/** explicit list of hidden triangles for each LOD of the part */
+	TriangleList,
+	/** a mask texture sampled at the vertex UVs marks hidden vertices */
+	Texture,
+	/** vertices whose normal hits an outer layer within CoverageDistance are hidden */
+	Coverage,
+};
+
+/**
+* Triangles of a part to drop when outer layers are merged over it.
+* Triangles are only dropped when all their vertices are hidden.
+*/
+struct FCMSkelMeshPartHideMask
+{
+	/** index in the source mesh list of the part whose triangles get hidden */
+	int32 MeshIndex = INDEX_NONE;
+	/** indices of the outer layer parts covering it, the mask only applies when one of them is merged. Every other part when empty */
+	TArray<int32> OuterLayerMeshIndices;
+	/** how hidden triangles are found */
+	ECMHideMaskMode Mode = ECMHideMaskMode::VertexColor;
+	/** VertexColor and Texture: color channel holding the mask, 0 to 3 for R, G, B, A */
+	uint8 Channel = 0;
+	/** VertexColor and Texture: vertices with a mask value above this are hidden */
+	uint8 Threshold = 127;
+	/** TriangleList: hidden triangles of each LOD, as triangle indices in the part LOD index buffer */
+	TArray<TArray<int32>> HiddenTrianglesPerLOD;
+	/** Texture: uncompressed B8G8R8A8 or G8 mask, its mip data must be CPU accessible */
+	UTexture2D* Texture = nullptr;
+	/** Texture: UV channel the mask is sampled with */
+	int32 UVChannel = 0;
+	/** Coverage: max distance along the vertex normal to an outer layer */
+	float CoverageDistance = 5.f;
+};
+
+/**
+* How the merged LOD count is chosen when the parts have different LOD counts
+*/
+enum class ECMMergedLODCount : uint8
+{
+	/** as many LODs as the part with the fewest LODs */
+	MinimumAcrossParts,
+	/** as many LODs as the main body, the first source mesh. Parts with fewer LODs reuse their closest (last) LOD */
+	MainBody,
+};
+
+/**
+* Source LOD a part is merged with at each merged LOD
+*/
+struct FCMSkelMeshPartLODMapping
+{
+	/** index in the source mesh list of the part */
+	int32 MeshIndex = INDEX_NONE;
+	/** source LOD used for each merged LOD, merged LODs past the end use the closest LOD */
+	TArray<int32> SourceLODs;
+};
+
+/**
+* How the bounds of the merged mesh are computed
+*/
+enum class ECMMergedBounds : uint8
+{
+	/** bounds of the vertex positions of the first merged LOD */
+	MergedVertices,
+	/** sum of the imported bounds of the parts */
+	SourceUnion,
+};
+
+/**
+* Vertex format of a merged LOD
+*/
+enum class ECMVertexFormatPolicy : uint8
+{
+	/** full precision UVs when a part of the LOD has them */
+	Source,
+	/** half precision UVs and 8 bit tangents */
+	Compact,
+	/** Compact when every UV of the parts with full precision UVs stays within VertexFormatUVTolerance of its half precision value, Source otherwise */
+	CompactWithinTolerance,
+};
+
+/**
+* Vertex streams of the merged mesh
+*/
+struct FCMSkelMeshVertexStreams
+{
+	/** bit N set when UV channel N is read. Only trailing channels can be dropped, channel 0 is always kept */
+	uint8 UVChannelMask = 0xFF;
+	/** vertex color stream read */
+	bool bVertexColors = true;
+};
+
+/**
+* Texture atlases parts are packed into so they merge into a single section
+*/
+struct FCMTextureAtlasOptions
+{
+	/** texture parameters of the part materials, each gets its own atlas. Parts whose materials share a parent share the atlases */
+	TArray<FName> TextureParameters;
+	/** UV channel the textures are sampled with, the only one the atlas transform is applied to */
+	int32 UVChannel = 0;
+	/** max width and height of an atlas, the parts are scaled down until they fit */
+	int32 MaxAtlasSize = 2048;
+	/** texels repeated around every part against bleeding between parts */
+	int32 Padding = 4;
+};
+
+/**
+* Merging of the sections of material instances that only differ in parameter values.
+* Every vertex of a merged section gets the index of its instance in the U of a UV channel, and the section gets a dynamic instance
+* of the shared parent with a table of the parameter values of every instance: one row per instance and one texel per parameter,
+* scalars in R then vectors, to sample at ((ParameterIdx + 0.5) / Width, (InstanceIdx + 0.5) / Height). The parent has to read it.
+*/
+struct FCMMaterialInstanceMergeOptions
+{
+	/** scalar parameters written to the table */
+	TArray<FName> ScalarParameters;
+	/** vector parameters written to the table, after the scalars */
+	TArray<FName> VectorParameters;
+	/** UV channel that gets the instance index, no part may use it */
+	int32 InstanceIndexUVChannel = 3;
+	/** texture parameter of the parent the table is bound to */
+	FName ParameterTableParameter = TEXT("ParameterTable");
+	/** vector parameter of the parent that gets (Width, Height, 1 / Width, 1 / Height) of the table */
+	FName ParameterTableSizeParameter = TEXT("ParameterTableSize");
+};
+
+/**
+* Optional processing applied to the merged mesh
+*/
+struct FCMSkelMeshMergeOptions
+{
+	/** collapse vertices that match in every attribute, such as the duplicated seams of modular parts */
+	bool bWeldVertices = false;
+	/** max distance between the positions of welded vertices */
+	float WeldPositionTolerance = THRESH_POINTS_ARE_SAME;
+	/** max 1 - dot between the normals and between the tangents of welded vertices */
+	float WeldTangentTolerance = 0.01f;
+	/** max difference of each UV coordinate of welded vertices */
+	float WeldUVTolerance = 1.f / 1024.f;
+	/** max difference of each color channel of welded vertices */
+	uint8 WeldColorTolerance = 0;
+	/** max difference of each skin weight of welded vertices, in 1/255 */
+	uint8 WeldSkinWeightTolerance = 1;
+
+	/** reorder the triangles and vertices of every merged section for vertex cache and vertex fetch locality */
+	bool bOptimizeVertexCache = false;
+
+	/** how the bounds of the merged mesh are computed */
+	ECMMergedBounds Bounds = ECMMergedBounds::MergedVertices;
+
+	/** how many LODs the merged mesh gets */
+	ECMMergedLODCount LODCount = ECMMergedLODCount::MinimumAcrossParts;
+	/** per part source LOD tables, parts without one use the source LOD closest to the merged LOD */
+	TArray<FCMSkelMeshPartLODMapping> LODMappings;
+	/** extra LODs appended after the ones chosen by LODCount, every part reuses its last LOD in them. Only used with bSimplifyReusedLODs, they would duplicate the last LOD otherwise */
+	int32 NumGeneratedLODs = 0;
+
+	/** simplify the LODs parts reuse past their last LOD instead of merging them at full detail */
+	bool bSimplifyReusedLODs = false;
+	/** fraction of its triangles a part keeps for every merged LOD it is past its last LOD */
+	float SimplifyTriangleRatio = 0.5f;
+	/** max root mean square distance of a collapsed vertex to the source triangles around it */
+	float SimplifyMaxError = 1.f;
+
+	/** max bone influences of every merged LOD, the smallest weights are dropped and the rest renormalized. Merged LODs past the end use the last entry, 0 keeps every influence */
+	TArray<int32> MaxBoneInfluencesPerLOD;
+
+	/** store only the non zero influences of every vertex behind a per vertex lookup, when unlimited bone influences are enabled (r.GPUSkin.UnlimitedBoneInfluences) */
+	bool bVariableBoneInfluences = false;
+
+	/** remove the bones no vertex is weighted to and no socket is attached to from the merged skeleton, and keep only the weighted bones active per LOD */
+	bool bPruneUnweightedBones = false;
+	/** bones kept by bPruneUnweightedBones even without weights, e.g. bones driving physics bodies or attachments */
+	TArray<FName> KeepBones;
+
+	/**
+	* allocate only the UV channels and the vertex color stream the merged materials read. Only the editor can tell: UV channels come from
+	* the texture streaming data, texture coordinate expressions and texture sample constant coordinates, vertex colors from vertex color
+	* expressions. Materials with custom expressions and every material outside the editor keep all the streams KeepVertexStreams allows
+	*/
+	bool bPruneVertexStreamsByMaterial = false;
+	/** vertex streams every merged LOD keeps at most, applied on top of bPruneVertexStreamsByMaterial */
+	FCMSkelMeshVertexStreams KeepVertexStreams;
+
+	/** vertex format of every merged LOD, merged LODs past the end use the last entry. Source for every LOD when empty */
+	TArray<ECMVertexFormatPolicy> VertexFormatPerLOD;
+	/** CompactWithinTolerance: max error of a half precision UV coordinate */
+	float VertexFormatUVTolerance = 1.f / 1024.f;
+
+	/** pack the textures of parts sharing a parent material into atlases and draw them with one material instance, built by FCharacterMergerLibrary::MergeRequest */
+	bool bBuildTextureAtlas = false;
+	/** atlas settings of bBuildTextureAtlas */
+	FCMTextureAtlasOptions TextureAtlas;
+
+	/** merge the sections of instances of the same parent material into one section, see FCMMaterialInstanceMergeOptions */
+	bool bMergeMaterialInstances = false;
+	/** settings of bMergeMaterialInstances */
+	FCMMaterialInstanceMergeOptions MaterialInstanceMerge;
+
+	/** morph targets applied to the merged vertices with a fixed weight, by name. They are left out of the merged mesh */
+	TMap<FName, float> BakedMorphWeights;
+	/** morph targets carried into the merged mesh, every one when empty */
+	TArray<FName> MorphTargetAllowList;
+	/** morph deltas moving their vertex more than this are kept */
+	float MorphPositionThreshold = THRESH_POINTS_ARE_NEAR;
+	/** morph deltas changing their normal more than this are kept even when they don't move it, by default only the position decides */
+	float MorphTangentThreshold = MAX_flt;
+	/** normal changes of the kept morph deltas below this are zeroed, which compresses better on the GPU */
+	float MorphTangentTolerance = 0.f;
+
+	/** triangles of inner parts to drop when outer layers are merged over them */
+	TArray<FCMSkelMeshPartHideMask> HideMasks;
+};
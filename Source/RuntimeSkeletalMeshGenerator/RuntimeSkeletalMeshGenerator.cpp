@@ -11,8 +11,38 @@
 /* `USkeletalMeshComponent`.                                                  */
 /******************************************************************************/
 #include "RuntimeSkeletalMeshGenerator.h"
+#include "RuntimeSkeletonBoneTransformExtractor.h"
 #include "Rendering/SkeletalMeshLODModel.h"
 #include "Rendering/SkeletalMeshModel.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogRuntimeSkeletalMeshGenerator, Log, All);
+
+DECLARE_STATS_GROUP(TEXT("RuntimeSkeletalMeshGenerator"), STATGROUP_RuntimeSkeletalMeshGenerator, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT(TEXT("GenerateSkeletalMesh"), STAT_RSMG_GenerateSkeletalMesh, STATGROUP_RuntimeSkeletalMeshGenerator);
+DECLARE_CYCLE_STAT(TEXT("DecomposeSkeletalMesh"), STAT_RSMG_DecomposeSkeletalMesh, STATGROUP_RuntimeSkeletalMeshGenerator);
+DECLARE_CYCLE_STAT(TEXT("InitializeSkeleton"), STAT_RSMG_InitializeSkeleton, STATGROUP_RuntimeSkeletalMeshGenerator);
+DECLARE_CYCLE_STAT(TEXT("RebindVertices"), STAT_RSMG_RebindVertices, STATGROUP_RuntimeSkeletalMeshGenerator);
+DECLARE_CYCLE_STAT(TEXT("GenerateLODModel"), STAT_RSMG_GenerateLODModel, STATGROUP_RuntimeSkeletalMeshGenerator);
+DECLARE_CYCLE_STAT(TEXT("GenerateNewSectionArray"), STAT_RSMG_GenerateNewSectionArray, STATGROUP_RuntimeSkeletalMeshGenerator);
+DECLARE_CYCLE_STAT(TEXT("CopyVertices"), STAT_RSMG_CopyVertices, STATGROUP_RuntimeSkeletalMeshGenerator);
+DECLARE_CYCLE_STAT(TEXT("RemapIndices"), STAT_RSMG_RemapIndices, STATGROUP_RuntimeSkeletalMeshGenerator);
+DECLARE_CYCLE_STAT(TEXT("InitResources"), STAT_RSMG_InitResources, STATGROUP_RuntimeSkeletalMeshGenerator);
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Generated Sections"), STAT_RSMG_NumSections, STATGROUP_RuntimeSkeletalMeshGenerator);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Generated Vertices"), STAT_RSMG_NumVertices, STATGROUP_RuntimeSkeletalMeshGenerator);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Generated Indices"), STAT_RSMG_NumIndices, STATGROUP_RuntimeSkeletalMeshGenerator);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Generated Bytes"), STAT_RSMG_NumBytes, STATGROUP_RuntimeSkeletalMeshGenerator);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Decomposed Morph Deltas"), STAT_RSMG_NumMorphDeltas, STATGROUP_RuntimeSkeletalMeshGenerator);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Rebound Vertices"), STAT_RSMG_NumReboundVertices, STATGROUP_RuntimeSkeletalMeshGenerator);
+
+// Cycle counter scope that still shows up in Unreal Insights when stats are compiled out.
+#if STATS
+	#define RSMG_SCOPE_CYCLE_COUNTER(Stat) SCOPE_CYCLE_COUNTER(Stat)
+#else
+	#define RSMG_SCOPE_CYCLE_COUNTER(Stat) TRACE_CPUPROFILER_EVENT_SCOPE(Stat)
+#endif
 
 void FRuntimeSkeletalMeshGeneratorModule::StartupModule()
 {
@@ -28,12 +58,40 @@ void FRuntimeSkeletalMeshGenerator::GenerateSkeletalMesh(
 	USkeletalMesh* SourceMesh,
 	TArray<FMeshSurface>& Surfaces,
 	const TArray<UMaterialInterface*>& SurfacesMaterial,
-	const TMap<FName, FTransform>& BoneTransformsOverride)
+	const TMap<FName, FTransform>& BoneTransformsOverride,
+	TMap<FName, TArray<FMorphTargetDelta>>* InOutMorphMap)
 {
+	RSMG_SCOPE_CYCLE_COUNTER(STAT_RSMG_GenerateSkeletalMesh);
+
 	// Waits the rendering thread has done.
 	FlushRenderingCommands();
 
-	InitializeSkeleton(SkeletalMesh, SourceMesh);
+	InitializeSkeleton(SkeletalMesh, SourceMesh, BoneTransformsOverride);
+
+	// Skin the source vertices into the overridden bind pose.
+	FRebindVertexData RebindVertexData;
+	const FRebindVertexData* RebindData = nullptr;
+	TArray<FMatrix> RebindMatrices;
+	if (SourceMesh && BoneTransformsOverride.Num() > 0 && ComputeRebindMatrices(SourceMesh->GetRefSkeleton(), SkeletalMesh->GetRefSkeleton(), RebindMatrices))
+	{
+		const FSkeletalMeshLODRenderData& SrcLODData = SourceMesh->GetResourceForRendering()->LODRenderData[0];
+
+		const double RebindStartTime = FPlatformTime::Seconds();
+		RebindVertices(SrcLODData, Surfaces, RebindMatrices, RebindVertexData);
+		const double RebindSeconds = FPlatformTime::Seconds() - RebindStartTime;
+
+		if (InOutMorphMap)
+		{
+			RebindMorphDeltas(SrcLODData, RebindMatrices, *InOutMorphMap);
+		}
+
+		const int32 NumReboundVertices = RebindVertexData.Positions.Num();
+		INC_DWORD_STAT_BY(STAT_RSMG_NumReboundVertices, NumReboundVertices);
+		UE_LOG(LogRuntimeSkeletalMeshGenerator, Verbose, TEXT("Rebound %d vertices in %.3fms (%.2fM vertices/s)"),
+			NumReboundVertices, RebindSeconds * 1000.0, RebindSeconds > 0.0 ? NumReboundVertices / RebindSeconds / 1000000.0 : 0.0);
+
+		RebindData = &RebindVertexData;
+	}
 
 	/*constexpr int32 LODIndex = 0;
 
@@ -319,16 +377,16 @@ void FRuntimeSkeletalMeshGenerator::GenerateSkeletalMesh(
 			switch( PerLODNumUVSets[0])
 			{
 			case 1:
-				GenerateLODModel< TGPUSkinVertexFloat16Uvs<1> >( SkeletalMesh, SourceMesh, Surfaces, RemapingBones, LODIdx );
+				GenerateLODModel< TGPUSkinVertexFloat16Uvs<1> >( SkeletalMesh, SourceMesh, Surfaces, RemapingBones, LODIdx, RebindData );
 				break;
 			case 2:
-				GenerateLODModel< TGPUSkinVertexFloat16Uvs<2> >( SkeletalMesh, SourceMesh,  Surfaces, RemapingBones, LODIdx );
+				GenerateLODModel< TGPUSkinVertexFloat16Uvs<2> >( SkeletalMesh, SourceMesh,  Surfaces, RemapingBones, LODIdx, RebindData );
 				break;
 			case 3:
-				GenerateLODModel< TGPUSkinVertexFloat16Uvs<3> >( SkeletalMesh, SourceMesh,  Surfaces, RemapingBones, LODIdx );
+				GenerateLODModel< TGPUSkinVertexFloat16Uvs<3> >( SkeletalMesh, SourceMesh,  Surfaces, RemapingBones, LODIdx, RebindData );
 				break;
 			case 4:
-				GenerateLODModel< TGPUSkinVertexFloat16Uvs<4> >( SkeletalMesh, SourceMesh, Surfaces, RemapingBones, LODIdx );
+				GenerateLODModel< TGPUSkinVertexFloat16Uvs<4> >( SkeletalMesh, SourceMesh, Surfaces, RemapingBones, LODIdx, RebindData );
 				break;
 			default:
 				checkf(false, TEXT("Invalid number of UV sets.  Must be between 0 and 4") );
@@ -340,16 +398,16 @@ void FRuntimeSkeletalMeshGenerator::GenerateSkeletalMesh(
 			switch( PerLODNumUVSets[0])
 			{
 			case 1:
-				GenerateLODModel< TGPUSkinVertexFloat32Uvs<1> >( SkeletalMesh, SourceMesh, Surfaces, RemapingBones, LODIdx );
+				GenerateLODModel< TGPUSkinVertexFloat32Uvs<1> >( SkeletalMesh, SourceMesh, Surfaces, RemapingBones, LODIdx, RebindData );
 				break;
 			case 2:
-				GenerateLODModel< TGPUSkinVertexFloat32Uvs<2> >( SkeletalMesh, SourceMesh, Surfaces, RemapingBones, LODIdx );
+				GenerateLODModel< TGPUSkinVertexFloat32Uvs<2> >( SkeletalMesh, SourceMesh, Surfaces, RemapingBones, LODIdx, RebindData );
 				break;
 			case 3:
-				GenerateLODModel< TGPUSkinVertexFloat32Uvs<3> >( SkeletalMesh, SourceMesh, Surfaces, RemapingBones, LODIdx );
+				GenerateLODModel< TGPUSkinVertexFloat32Uvs<3> >( SkeletalMesh, SourceMesh, Surfaces, RemapingBones, LODIdx, RebindData );
 				break;
 			case 4:
-				GenerateLODModel< TGPUSkinVertexFloat32Uvs<4> >( SkeletalMesh, SourceMesh, Surfaces, RemapingBones, LODIdx );
+				GenerateLODModel< TGPUSkinVertexFloat32Uvs<4> >( SkeletalMesh, SourceMesh, Surfaces, RemapingBones, LODIdx, RebindData );
 				break;
 			default:
 				checkf(false, TEXT("Invalid number of UV sets.  Must be between 0 and 4") );
@@ -362,7 +420,7 @@ void FRuntimeSkeletalMeshGenerator::GenerateSkeletalMesh(
 	if(SourceMesh)
 	{
 		// initialize the merged mesh with the first src mesh entry used
-		SkeletalMesh->SetImportedBounds(SourceMesh->GetImportedBounds());
+		SkeletalMesh->SetImportedBounds(RebindData ? FBoxSphereBounds(RebindData->Bounds) : SourceMesh->GetImportedBounds());
 
 		SkeletalMesh->SetSkelMirrorAxis(SourceMesh->GetSkelMirrorAxis());
 		SkeletalMesh->SetSkelMirrorFlipAxis(SourceMesh->GetSkelMirrorFlipAxis());
@@ -380,7 +438,10 @@ void FRuntimeSkeletalMeshGenerator::GenerateSkeletalMesh(
 	}
 
 	// Reinitialize the mesh's render resources.
-	SkeletalMesh->InitResources();
+	{
+		RSMG_SCOPE_CYCLE_COUNTER(STAT_RSMG_InitResources);
+		SkeletalMesh->InitResources();
+	}
 }
 
 bool FRuntimeSkeletalMeshGenerator::DecomposeSkeletalMesh(
@@ -397,6 +458,8 @@ bool FRuntimeSkeletalMeshGenerator::DecomposeSkeletalMesh(
 	/// Out Materials used.
 	TArray<UMaterialInterface*>& OutSurfacesMaterial)
 {
+	RSMG_SCOPE_CYCLE_COUNTER(STAT_RSMG_DecomposeSkeletalMesh);
+
 	OutSurfaces.Empty();
 	OutSurfacesVertexOffsets.Empty();
 	OutSurfacesIndexOffsets.Empty();
@@ -425,6 +488,7 @@ bool FRuntimeSkeletalMeshGenerator::DecomposeSkeletalMesh(
 		{
 			OutMorphMap[MorphName].Add(TargetDelta);
 		}
+		INC_DWORD_STAT_BY(STAT_RSMG_NumMorphDeltas, Target->MorphLODModels[0].Vertices.Num());
 	}
 
 	TArray<uint32> IndexBuffer;
@@ -539,6 +603,8 @@ void FRuntimeSkeletalMeshGenerator::BoneMapToNewRefSkel(const TArray<FBoneIndexT
 void FRuntimeSkeletalMeshGenerator::GenerateNewSectionArray(USkeletalMesh* SrcMesh, TArray<int32>& SectionRemapingContainer, TArray<FCMNewSectionInfo>& NewSectionArray,
 	int32 LODIdx)
 {
+	RSMG_SCOPE_CYCLE_COUNTER(STAT_RSMG_GenerateNewSectionArray);
+
 	const int32 MaxGPUSkinBones = FGPUBaseSkinVertexFactory::GetMaxGPUSkinBones();
 
 	NewSectionArray.Empty();
@@ -641,15 +707,39 @@ void FRuntimeSkeletalMeshGenerator::GenerateNewSectionArray(USkeletalMesh* SrcMe
 		}
 }
 
+/**
+* Position of a source vertex, taken from the surface of its render section so the positions edited by the caller are kept.
+* Falls back to the source position buffer for vertices no surface covers.
+*/
+static FORCEINLINE const FVector& GetSurfacePosition(const FSkeletalMeshLODRenderData& SrcLODData, const TArray<FMeshSurface>& Surfaces, int32 SourceVertIdx)
+{
+	int32 SectionIdx = INDEX_NONE;
+	int32 SectionVertIdx = INDEX_NONE;
+	SrcLODData.GetSectionFromVertexIndex(SourceVertIdx, SectionIdx, SectionVertIdx);
+	if (Surfaces.IsValidIndex(SectionIdx) && Surfaces[SectionIdx].Vertices.IsValidIndex(SectionVertIdx))
+	{
+		return Surfaces[SectionIdx].Vertices[SectionVertIdx];
+	}
+	return SrcLODData.StaticVertexBuffers.PositionVertexBuffer.VertexPosition(SourceVertIdx);
+}
+
 template <typename VertexDataType>
 void FRuntimeSkeletalMeshGenerator::CopyVertexFromSource(VertexDataType& DestVert, const FSkeletalMeshLODRenderData& SrcLODData, const TArray<FMeshSurface>& Surfaces, int32 SourceVertIdx,
-	const FCMMergeSectionInfo& MergeSectionInfo)
+	const FCMMergeSectionInfo& MergeSectionInfo, const FRebindVertexData* RebindData)
 {
-	/**Find vertex right index */
-	//DestVert.Position = SrcLODData.StaticVertexBuffers.PositionVertexBuffer.VertexPosition(SourceVertIdx) ;
-	DestVert.Position = Surfaces[0].Vertices[SourceVertIdx];
-	DestVert.TangentX = SrcLODData.StaticVertexBuffers.StaticMeshVertexBuffer.VertexTangentX(SourceVertIdx);
-	DestVert.TangentZ = SrcLODData.StaticVertexBuffers.StaticMeshVertexBuffer.VertexTangentZ(SourceVertIdx);
+	if (RebindData)
+	{
+		// rebound from the same surface positions and source tangents as below
+		DestVert.Position = FVector(RebindData->Positions[SourceVertIdx]);
+		DestVert.TangentX = RebindData->TangentsX[SourceVertIdx];
+		DestVert.TangentZ = RebindData->TangentsZ[SourceVertIdx];
+	}
+	else
+	{
+		DestVert.Position = GetSurfacePosition(SrcLODData, Surfaces, SourceVertIdx);
+		DestVert.TangentX = SrcLODData.StaticVertexBuffers.StaticMeshVertexBuffer.VertexTangentX(SourceVertIdx);
+		DestVert.TangentZ = SrcLODData.StaticVertexBuffers.StaticMeshVertexBuffer.VertexTangentZ(SourceVertIdx);
+	}
 
 	// Copy all UVs that are available
 	uint32 LODNumTexCoords = SrcLODData.StaticVertexBuffers.StaticMeshVertexBuffer.GetNumTexCoords();
@@ -672,9 +762,91 @@ void FRuntimeSkeletalMeshGenerator::CopyVertexFromSource(VertexDataType& DestVer
 	}
 }
 
+/**
+* Builds the duplicated vertices buffer of a new section from all its merge sections in one pass.
+* Must be called once Section.NumVertices is final.
+* @param Section - new render section to fill
+* @param NewSectionInfo - merge sections making up the new section, in vertex order
+*/
+void FRuntimeSkeletalMeshGenerator::GenerateDuplicatedVertices(FSkelMeshRenderSection& Section, const FCMNewSectionInfo& NewSectionInfo)
+{
+	// exact sizes of the merged buffers
+	bool bHasOverlappingVertices = false;
+	int32 NumDupVerts = 0;
+	for (const FCMMergeSectionInfo& MergeSectionInfo : NewSectionInfo.MergeSections)
+	{
+		const FDuplicatedVerticesBuffer& SrcDupVerts = MergeSectionInfo.Section->DuplicatedVerticesBuffer;
+		if (SrcDupVerts.bHasOverlappingVertices)
+		{
+			bHasOverlappingVertices = true;
+			NumDupVerts += SrcDupVerts.DupVertData.Num();
+		}
+	}
+
+	FDuplicatedVerticesBuffer& DupVerts = Section.DuplicatedVerticesBuffer;
+	DupVerts.bHasOverlappingVertices = bHasOverlappingVertices;
+	DupVerts.DupVertData.ResizeBuffer(FMath::Max(NumDupVerts, 1));
+	DupVerts.DupVertIndexData.ResizeBuffer(Section.NumVertices);
+
+	uint32* VertData = (uint32*)DupVerts.DupVertData.GetDataPointer();
+	FIndexLengthPair* IndexData = (FIndexLengthPair*)DupVerts.DupVertIndexData.GetDataPointer();
+
+	if (!bHasOverlappingVertices)
+	{
+		FMemory::Memzero(VertData, sizeof(uint32));
+		FMemory::Memzero(IndexData, Section.NumVertices * sizeof(FIndexLengthPair));
+		return;
+	}
+
+	// running offsets of each merge section into the merged buffers
+	int32 DupVertOffset = 0;
+	uint32 VertexOffset = 0;
+	for (const FCMMergeSectionInfo& MergeSectionInfo : NewSectionInfo.MergeSections)
+	{
+		const FSkelMeshRenderSection& SrcSection = *MergeSectionInfo.Section;
+		// GetDataPointer is not const, the source buffers are only read
+		FDuplicatedVerticesBuffer& SrcDupVerts = const_cast<FDuplicatedVerticesBuffer&>(SrcSection.DuplicatedVerticesBuffer);
+		const uint32 NumSrcVertices = FMath::Min<uint32>(SrcSection.NumVertices, Section.NumVertices - VertexOffset);
+
+		if (SrcDupVerts.bHasOverlappingVertices)
+		{
+			// same offset as the remapped indices of this merge section
+			const uint32 VertIndexOffset = Section.BaseVertexIndex + VertexOffset - SrcSection.BaseVertexIndex;
+			const uint32* SrcVertData = (const uint32*)SrcDupVerts.DupVertData.GetDataPointer();
+			const int32 NumSrcDupVerts = SrcDupVerts.DupVertData.Num();
+			for (int32 i = 0; i < NumSrcDupVerts; ++i)
+			{
+				VertData[DupVertOffset + i] = SrcVertData[i] + VertIndexOffset;
+			}
+
+			const FIndexLengthPair* SrcIndexData = (const FIndexLengthPair*)SrcDupVerts.DupVertIndexData.GetDataPointer();
+			const uint32 NumSrcIndexData = FMath::Min<uint32>(NumSrcVertices, SrcDupVerts.DupVertIndexData.Num());
+			for (uint32 i = 0; i < NumSrcIndexData; ++i)
+			{
+				IndexData[VertexOffset + i].Index = SrcIndexData[i].Index + DupVertOffset;
+				IndexData[VertexOffset + i].Length = SrcIndexData[i].Length;
+			}
+			if (NumSrcIndexData < NumSrcVertices)
+			{
+				FMemory::Memzero(IndexData + VertexOffset + NumSrcIndexData, (NumSrcVertices - NumSrcIndexData) * sizeof(FIndexLengthPair));
+			}
+
+			DupVertOffset += NumSrcDupVerts;
+		}
+		else
+		{
+			FMemory::Memzero(IndexData + VertexOffset, NumSrcVertices * sizeof(FIndexLengthPair));
+		}
+
+		VertexOffset += NumSrcVertices;
+	}
+}
+
 template <typename VertexDataType>
-void FRuntimeSkeletalMeshGenerator::GenerateLODModel(USkeletalMesh* MergeMesh, USkeletalMesh* SourceMesh, const TArray<FMeshSurface>& Surfaces, TArray<int32> SectionRemapping, int32 LODIdx)
+void FRuntimeSkeletalMeshGenerator::GenerateLODModel(USkeletalMesh* MergeMesh, USkeletalMesh* SourceMesh, const TArray<FMeshSurface>& Surfaces, TArray<int32> SectionRemapping, int32 LODIdx, const FRebindVertexData* RebindData)
 {
+	RSMG_SCOPE_CYCLE_COUNTER(STAT_RSMG_GenerateLODModel);
+
 	// add the new LOD model entry
 	FSkeletalMeshRenderData* MergeResource = MergeMesh->GetResourceForRendering();
 	check(MergeResource);
@@ -815,46 +987,49 @@ void FRuntimeSkeletalMeshGenerator::GenerateLODModel(USkeletalMesh* MergeMesh, U
 			int32 CurrentBaseVertexIndex = MergedVertexBuffer.Num();
 			const uint32 MaxBoneInfluences = SrcLODData.GetSkinWeightVertexBuffer()->GetMaxBoneInfluences();
 			const bool bUse16BitBoneIndex = SrcLODData.GetSkinWeightVertexBuffer()->Use16BitBoneIndex();
-			for( int32 VertIdx=MergeSectionInfo.Section->BaseVertexIndex; VertIdx < MaxVertIdx; VertIdx++ )
 			{
-				// add the new vertex
-				VertexDataType& DestVert = MergedVertexBuffer[MergedVertexBuffer.AddUninitialized()];
-				FSkinWeightInfo& DestWeight = MergedSkinWeightBuffer[MergedSkinWeightBuffer.AddUninitialized()];
+				RSMG_SCOPE_CYCLE_COUNTER(STAT_RSMG_CopyVertices);
+				for( int32 VertIdx=MergeSectionInfo.Section->BaseVertexIndex; VertIdx < MaxVertIdx; VertIdx++ )
+				{
+					// add the new vertex
+					VertexDataType& DestVert = MergedVertexBuffer[MergedVertexBuffer.AddUninitialized()];
+					FSkinWeightInfo& DestWeight = MergedSkinWeightBuffer[MergedSkinWeightBuffer.AddUninitialized()];
 
-				CopyVertexFromSource<VertexDataType>(DestVert, SrcLODData, Surfaces, VertIdx, MergeSectionInfo);
+					CopyVertexFromSource<VertexDataType>(DestVert, SrcLODData, Surfaces, VertIdx, MergeSectionInfo, RebindData);
 
-				SourceMaxBoneInfluences = FMath::Max(SourceMaxBoneInfluences, MaxBoneInfluences);
-				bSourceUse16BitBoneIndex |= bUse16BitBoneIndex;
-				DestWeight = SrcLODData.GetSkinWeightVertexBuffer()->GetVertexSkinWeights(VertIdx);
+					SourceMaxBoneInfluences = FMath::Max(SourceMaxBoneInfluences, MaxBoneInfluences);
+					bSourceUse16BitBoneIndex |= bUse16BitBoneIndex;
+					DestWeight = SrcLODData.GetSkinWeightVertexBuffer()->GetVertexSkinWeights(VertIdx);
 
-				// if the mesh uses vertex colors, copy the source color if possible or default to white
-				if( MergeMesh->GetHasVertexColors() )
-				{
-					if( VertIdx < MaxColorIdx )
+					// if the mesh uses vertex colors, copy the source color if possible or default to white
+					if( MergeMesh->GetHasVertexColors() )
 					{
-						const FColor& SrcColor = SrcLODData.StaticVertexBuffers.ColorVertexBuffer.VertexColor(VertIdx);
-						MergedColorBuffer.Add(SrcColor);
+						if( VertIdx < MaxColorIdx )
+						{
+							const FColor& SrcColor = SrcLODData.StaticVertexBuffers.ColorVertexBuffer.VertexColor(VertIdx);
+							MergedColorBuffer.Add(SrcColor);
+						}
+						else
+						{
+							const FColor ColorWhite(255, 255, 255);
+							MergedColorBuffer.Add(ColorWhite);
+						}
 					}
-					else
+
+					uint32 LODNumTexCoords = SrcLODData.StaticVertexBuffers.StaticMeshVertexBuffer.GetNumTexCoords();
+					if( TotalNumUVs < LODNumTexCoords )
 					{
-						const FColor ColorWhite(255, 255, 255);
-						MergedColorBuffer.Add(ColorWhite);
+						TotalNumUVs = LODNumTexCoords;
 					}
-				}
 
-				uint32 LODNumTexCoords = SrcLODData.StaticVertexBuffers.StaticMeshVertexBuffer.GetNumTexCoords();
-				if( TotalNumUVs < LODNumTexCoords )
-				{
-					TotalNumUVs = LODNumTexCoords;
-				}
-
-				// remap the bone index used by this vertex to match the mergedbonemap 
-				for( uint32 Idx=0; Idx < MAX_TOTAL_INFLUENCES; Idx++ )
-				{
-					if (DestWeight.InfluenceWeights[Idx] > 0)
+					// remap the bone index used by this vertex to match the mergedbonemap 
+					for( uint32 Idx=0; Idx < MAX_TOTAL_INFLUENCES; Idx++ )
 					{
-						checkSlow(MergeSectionInfo.BoneMapToMergedBoneMap.IsValidIndex(DestWeight.InfluenceBones[Idx]));
-						DestWeight.InfluenceBones[Idx] = (uint8)MergeSectionInfo.BoneMapToMergedBoneMap[DestWeight.InfluenceBones[Idx]];
+						if (DestWeight.InfluenceWeights[Idx] > 0)
+						{
+							checkSlow(MergeSectionInfo.BoneMapToMergedBoneMap.IsValidIndex(DestWeight.InfluenceBones[Idx]));
+							DestWeight.InfluenceBones[Idx] = (uint8)MergeSectionInfo.BoneMapToMergedBoneMap[DestWeight.InfluenceBones[Idx]];
+						}
 					}
 				}
 			}
@@ -867,71 +1042,29 @@ void FRuntimeSkeletalMeshGenerator::GenerateLODModel(USkeletalMesh* MergeMesh, U
 				MergeSectionInfo.Section->BaseIndex + MergeSectionInfo.Section->NumTriangles * 3, 
 				SrcLODData.MultiSizeIndexContainer.GetIndexBuffer()->Num()
 				);
-            for (int32 IndexIdx = MergeSectionInfo.Section->BaseIndex; IndexIdx < MaxIndexIdx; IndexIdx++)
             {
-                uint32 SrcIndex = SrcLODData.MultiSizeIndexContainer.GetIndexBuffer()->Get(IndexIdx);
-
-                // add offset to each index to match the new entries in the merged vertex buffer
-                checkSlow(SrcIndex >= MergeSectionInfo.Section->BaseVertexIndex);
-                uint32 DstIndex = SrcIndex - MergeSectionInfo.Section->BaseVertexIndex + CurrentBaseVertexIndex;
-                checkSlow(DstIndex < (uint32)MergedVertexBuffer.Num());
-
-                // add the new index to the merged vertex buffer
-                MergedIndexBuffer.Add(DstIndex);
-                if (MaxIndex < DstIndex)
+                RSMG_SCOPE_CYCLE_COUNTER(STAT_RSMG_RemapIndices);
+                for (int32 IndexIdx = MergeSectionInfo.Section->BaseIndex; IndexIdx < MaxIndexIdx; IndexIdx++)
                 {
-                    MaxIndex = DstIndex;
-                }
+                    uint32 SrcIndex = SrcLODData.MultiSizeIndexContainer.GetIndexBuffer()->Get(IndexIdx);
 
-            }
+                    // add offset to each index to match the new entries in the merged vertex buffer
+                    checkSlow(SrcIndex >= MergeSectionInfo.Section->BaseVertexIndex);
+                    uint32 DstIndex = SrcIndex - MergeSectionInfo.Section->BaseVertexIndex + CurrentBaseVertexIndex;
+                    checkSlow(DstIndex < (uint32)MergedVertexBuffer.Num());
 
-            {
-                if (MergeSectionInfo.Section->DuplicatedVerticesBuffer.bHasOverlappingVertices)
-                {
-                    if (Section.DuplicatedVerticesBuffer.bHasOverlappingVertices)
+                    // add the new index to the merged vertex buffer
+                    MergedIndexBuffer.Add(DstIndex);
+                    if (MaxIndex < DstIndex)
                     {
-                        // Merge
-                        int32 StartIndex = Section.DuplicatedVerticesBuffer.DupVertData.Num();
-                        int32 StartVertex = Section.DuplicatedVerticesBuffer.DupVertIndexData.Num();
-                        Section.DuplicatedVerticesBuffer.DupVertData.ResizeBuffer(StartIndex + MergeSectionInfo.Section->DuplicatedVerticesBuffer.DupVertData.Num());
-                        Section.DuplicatedVerticesBuffer.DupVertIndexData.ResizeBuffer(Section.NumVertices);
-                    
-                        uint8* VertData = Section.DuplicatedVerticesBuffer.DupVertData.GetDataPointer();
-                        uint8* IndexData = Section.DuplicatedVerticesBuffer.DupVertIndexData.GetDataPointer();
-                        for (int32 i = StartIndex; i < Section.DuplicatedVerticesBuffer.DupVertData.Num(); ++i)
-                        {
-                            *((uint32*)(VertData + i * sizeof(uint32))) += CurrentBaseVertexIndex - MergeSectionInfo.Section->BaseVertexIndex;
-                        }
-                        for (uint32 i = StartVertex; i < Section.NumVertices; ++i)
-                        {
-                            ((FIndexLengthPair*)(IndexData + i * sizeof(FIndexLengthPair)))->Index += StartIndex;
-                        }
+                        MaxIndex = DstIndex;
                     }
-                    else
-                    {
-                        Section.DuplicatedVerticesBuffer.DupVertData = MergeSectionInfo.Section->DuplicatedVerticesBuffer.DupVertData;
-                        Section.DuplicatedVerticesBuffer.DupVertIndexData = MergeSectionInfo.Section->DuplicatedVerticesBuffer.DupVertIndexData;
-                        uint8* VertData = Section.DuplicatedVerticesBuffer.DupVertData.GetDataPointer();
-                        for (int32 i = 0; i < Section.DuplicatedVerticesBuffer.DupVertData.Num(); ++i)
-                        {
-                            *((uint32*)(VertData + i * sizeof(uint32))) += CurrentBaseVertexIndex - MergeSectionInfo.Section->BaseVertexIndex;
-                        }
-                    }
-                    Section.DuplicatedVerticesBuffer.bHasOverlappingVertices = true;
-                }
-                else
-                {
-                    Section.DuplicatedVerticesBuffer.DupVertData.ResizeBuffer(1);
-                    Section.DuplicatedVerticesBuffer.DupVertIndexData.ResizeBuffer(Section.NumVertices);
-
-                    uint8* VertData = Section.DuplicatedVerticesBuffer.DupVertData.GetDataPointer();
-                    uint8* IndexData = Section.DuplicatedVerticesBuffer.DupVertIndexData.GetDataPointer();
-                    
-                    FMemory::Memzero(IndexData, Section.NumVertices * sizeof(FIndexLengthPair));
-                    FMemory::Memzero(VertData, sizeof(uint32));
+
                 }
             }
 		}
+
+		GenerateDuplicatedVertices(Section, NewSectionInfo);
 	}
 
     const bool bNeedsCPUAccess = true;
@@ -971,25 +1104,202 @@ void FRuntimeSkeletalMeshGenerator::GenerateLODModel(USkeletalMesh* MergeMesh, U
 	
 	const uint8 DataTypeSize = (MaxIndex < MAX_uint16) ? sizeof(uint16) : sizeof(uint32);
 	MergeLODData.MultiSizeIndexContainer.RebuildIndexBuffer(DataTypeSize, MergedIndexBuffer);
+
+	INC_DWORD_STAT_BY(STAT_RSMG_NumSections, MergeLODData.RenderSections.Num());
+	INC_DWORD_STAT_BY(STAT_RSMG_NumVertices, MergedVertexBuffer.Num());
+	INC_DWORD_STAT_BY(STAT_RSMG_NumIndices, MergedIndexBuffer.Num());
+	INC_DWORD_STAT_BY(STAT_RSMG_NumBytes,
+		MergeLODData.StaticVertexBuffers.PositionVertexBuffer.GetNumVertices() * MergeLODData.StaticVertexBuffers.PositionVertexBuffer.GetStride() +
+		MergeLODData.StaticVertexBuffers.StaticMeshVertexBuffer.GetResourceSize() +
+		MergeLODData.StaticVertexBuffers.ColorVertexBuffer.GetNumVertices() * MergeLODData.StaticVertexBuffers.ColorVertexBuffer.GetStride() +
+		MergeLODData.SkinWeightVertexBuffer.GetVertexDataSize() +
+		MergedIndexBuffer.Num() * DataTypeSize);
 }
-void FRuntimeSkeletalMeshGenerator::InitializeSkeleton(USkeletalMesh* MergeMesh, USkeletalMesh* SrcMesh)
+void FRuntimeSkeletalMeshGenerator::InitializeSkeleton(USkeletalMesh* MergeMesh, USkeletalMesh* SrcMesh, const TMap<FName, FTransform>& BoneTransformsOverride)
 {
-	FReferenceSkeleton RefSkeleton;
+	RSMG_SCOPE_CYCLE_COUNTER(STAT_RSMG_InitializeSkeleton);
 
-	// Iterate through all the source mesh reference skeletons and compose the merged reference skeleton.
-	FReferenceSkeletonModifier RefSkelModifier(RefSkeleton, MergeMesh->GetSkeleton());
+	FReferenceSkeleton RefSkeleton;
 	if (!SrcMesh)
 	{
 		return;
 	}
 
-	// Initialise new RefSkeleton with first mesh.
-	if (RefSkeleton.GetRawBoneNum() == 0)
 	{
+		// Initialise new RefSkeleton with the source mesh, the final pose is rebuilt when the modifier goes out of scope.
+		FReferenceSkeletonModifier RefSkelModifier(RefSkeleton, MergeMesh->GetSkeleton());
 		RefSkeleton = SrcMesh->GetRefSkeleton();
+
+		// Replace the local transform of the overridden bones.
+		for (const TPair<FName, FTransform>& TransformOverride : BoneTransformsOverride)
+		{
+			const int32 BoneIndex = RefSkelModifier.FindBoneIndex(TransformOverride.Key);
+			if (BoneIndex != INDEX_NONE)
+			{
+				RefSkelModifier.UpdateRefPoseTransform(BoneIndex, TransformOverride.Value);
+			}
+		}
 	}
 
 	MergeMesh->SetRefSkeleton(RefSkeleton);
 	MergeMesh->GetRefBasesInvMatrix().Empty();
 	MergeMesh->CalculateInvRefMatrices();
-}
\ No newline at end of file
+}
+
+/**
+* Computes the matrices moving each bone from the bind pose of the source skeleton to the one of the generated skeleton.
+* Both skeletons must share their raw bone order.
+* @return false when no bone moved, the vertices can then be copied as they are
+*/
+bool FRuntimeSkeletalMeshGenerator::ComputeRebindMatrices(const FReferenceSkeleton& SrcRefSkeleton, const FReferenceSkeleton& RefSkeleton, TArray<FMatrix>& OutBoneMatrices)
+{
+	const TMap<FName, FTransform> NoPoseOffsets;
+	const FRuntimeSkeletonBoneTransformExtractor SrcBindPose(SrcRefSkeleton, NoPoseOffsets);
+	const FRuntimeSkeletonBoneTransformExtractor BindPose(RefSkeleton, NoPoseOffsets);
+	check(SrcBindPose.GetBoneNum() == BindPose.GetBoneNum());
+
+	bool bAnyBoneMoved = false;
+	OutBoneMatrices.SetNumUninitialized(BindPose.GetBoneNum());
+	for (int32 BoneIndex = 0; BoneIndex < OutBoneMatrices.Num(); BoneIndex++)
+	{
+		const FMatrix& SrcGlobalTransform = SrcBindPose.GetGlobalTransform(BoneIndex);
+		const FMatrix& GlobalTransform = BindPose.GetGlobalTransform(BoneIndex);
+		OutBoneMatrices[BoneIndex] = SrcGlobalTransform.Inverse() * GlobalTransform;
+		bAnyBoneMoved |= !SrcGlobalTransform.Equals(GlobalTransform);
+	}
+	return bAnyBoneMoved;
+}
+
+/** Blends the rebind matrices of the bones influencing a vertex by their weight, identity when the vertex has no weight */
+static FORCEINLINE void BlendRebindMatrices(const FSkinWeightInfo& Weights, uint32 MaxBoneInfluences, const TArray<FBoneIndexType>& BoneMap, const TArray<FMatrix>& BoneMatrices, VectorRegister OutRows[4])
+{
+	OutRows[0] = OutRows[1] = OutRows[2] = OutRows[3] = VectorZero();
+
+	bool bHasWeight = false;
+	for (uint32 InfluenceIdx = 0; InfluenceIdx < MaxBoneInfluences; InfluenceIdx++)
+	{
+		const uint8 Weight = Weights.InfluenceWeights[InfluenceIdx];
+		if (Weight == 0)
+		{
+			continue;
+		}
+
+		checkSlow(BoneMap.IsValidIndex(Weights.InfluenceBones[InfluenceIdx]));
+		const FMatrix& BoneMatrix = BoneMatrices[BoneMap[Weights.InfluenceBones[InfluenceIdx]]];
+		const VectorRegister VectorWeight = VectorSetFloat1(Weight * (1.f / 255.f));
+		OutRows[0] = VectorMultiplyAdd(VectorLoadAligned(BoneMatrix.M[0]), VectorWeight, OutRows[0]);
+		OutRows[1] = VectorMultiplyAdd(VectorLoadAligned(BoneMatrix.M[1]), VectorWeight, OutRows[1]);
+		OutRows[2] = VectorMultiplyAdd(VectorLoadAligned(BoneMatrix.M[2]), VectorWeight, OutRows[2]);
+		OutRows[3] = VectorMultiplyAdd(VectorLoadAligned(BoneMatrix.M[3]), VectorWeight, OutRows[3]);
+		bHasWeight = true;
+	}
+
+	if (!bHasWeight)
+	{
+		OutRows[0] = VectorLoadAligned(FMatrix::Identity.M[0]);
+		OutRows[1] = VectorLoadAligned(FMatrix::Identity.M[1]);
+		OutRows[2] = VectorLoadAligned(FMatrix::Identity.M[2]);
+		OutRows[3] = VectorLoadAligned(FMatrix::Identity.M[3]);
+	}
+}
+
+/** Transforms the XYZ of a direction by blended matrix rows, the result has a zero W */
+static FORCEINLINE VectorRegister TransformRebindDirection(const VectorRegister& Direction, const VectorRegister Rows[4])
+{
+	VectorRegister Result = VectorMultiply(VectorReplicate(Direction, 0), Rows[0]);
+	Result = VectorMultiplyAdd(VectorReplicate(Direction, 1), Rows[1], Result);
+	return VectorMultiplyAdd(VectorReplicate(Direction, 2), Rows[2], Result);
+}
+
+/**
+* Linear blend skins the vertices of the source LOD into the overridden bind pose.
+* Positions are read from the surfaces like CopyVertexFromSource does, the tangent basis from the source LOD.
+* Normals and tangents go through the same blended matrix, which is exact for rotations and uniform scales,
+* then the tangent is orthogonalized against the normal.
+*/
+void FRuntimeSkeletalMeshGenerator::RebindVertices(const FSkeletalMeshLODRenderData& SrcLODData, const TArray<FMeshSurface>& Surfaces, const TArray<FMatrix>& BoneMatrices, FRebindVertexData& OutVertexData)
+{
+	RSMG_SCOPE_CYCLE_COUNTER(STAT_RSMG_RebindVertices);
+
+	const FPositionVertexBuffer& PositionBuffer = SrcLODData.StaticVertexBuffers.PositionVertexBuffer;
+	const FStaticMeshVertexBuffer& TangentBuffer = SrcLODData.StaticVertexBuffers.StaticMeshVertexBuffer;
+	const FSkinWeightVertexBuffer& SkinWeightBuffer = *SrcLODData.GetSkinWeightVertexBuffer();
+	const uint32 MaxBoneInfluences = SkinWeightBuffer.GetMaxBoneInfluences();
+	const int32 NumVertices = PositionBuffer.GetNumVertices();
+
+	// decode the source vertices into aligned arrays the kernel rebinds in place
+	OutVertexData.Positions.SetNumUninitialized(NumVertices);
+	OutVertexData.TangentsX.SetNumUninitialized(NumVertices);
+	OutVertexData.TangentsZ.SetNumUninitialized(NumVertices);
+	for (int32 VertIdx = 0; VertIdx < NumVertices; VertIdx++)
+	{
+		OutVertexData.Positions[VertIdx] = FVector4(GetSurfacePosition(SrcLODData, Surfaces, VertIdx), 1.f);
+		OutVertexData.TangentsX[VertIdx] = TangentBuffer.VertexTangentX(VertIdx);
+		OutVertexData.TangentsZ[VertIdx] = TangentBuffer.VertexTangentZ(VertIdx);
+	}
+
+	VectorRegister BoundsMin = VectorSetFloat1(MAX_flt);
+	VectorRegister BoundsMax = VectorSetFloat1(-MAX_flt);
+	for (const FSkelMeshRenderSection& Section : SrcLODData.RenderSections)
+	{
+		const int32 LastVertIdx = FMath::Min<int32>(Section.BaseVertexIndex + Section.NumVertices, NumVertices);
+		for (int32 VertIdx = Section.BaseVertexIndex; VertIdx < LastVertIdx; VertIdx++)
+		{
+			VectorRegister Rows[4];
+			BlendRebindMatrices(SkinWeightBuffer.GetVertexSkinWeights(VertIdx), MaxBoneInfluences, Section.BoneMap, BoneMatrices, Rows);
+
+			FVector4& Position = OutVertexData.Positions[VertIdx];
+			const VectorRegister ReboundPosition = VectorAdd(TransformRebindDirection(VectorLoadAligned(&Position), Rows), Rows[3]);
+			VectorStoreAligned(ReboundPosition, &Position);
+			BoundsMin = VectorMin(BoundsMin, ReboundPosition);
+			BoundsMax = VectorMax(BoundsMax, ReboundPosition);
+
+			FVector4& TangentZ = OutVertexData.TangentsZ[VertIdx];
+			const float BinormalSign = TangentZ.W;
+			const VectorRegister ReboundTangentZ = VectorNormalize(TransformRebindDirection(VectorLoadAligned(&TangentZ), Rows));
+			VectorStoreAligned(ReboundTangentZ, &TangentZ);
+			TangentZ.W = BinormalSign;
+
+			FVector4& TangentX = OutVertexData.TangentsX[VertIdx];
+			const VectorRegister TransformedTangentX = TransformRebindDirection(VectorLoadAligned(&TangentX), Rows);
+			const VectorRegister ReboundTangentX = VectorNormalize(VectorSubtract(TransformedTangentX, VectorMultiply(VectorDot3(TransformedTangentX, ReboundTangentZ), ReboundTangentZ)));
+			VectorStoreAligned(ReboundTangentX, &TangentX);
+		}
+	}
+
+	OutVertexData.Bounds.Init();
+	if (NumVertices > 0)
+	{
+		VectorStoreFloat3(BoundsMin, &OutVertexData.Bounds.Min);
+		VectorStoreFloat3(BoundsMax, &OutVertexData.Bounds.Max);
+		OutVertexData.Bounds.IsValid = 1;
+	}
+}
+
+/** Rotates the morph deltas with the blended rebind matrix of their vertex, like RebindVertices moves the vertex */
+void FRuntimeSkeletalMeshGenerator::RebindMorphDeltas(const FSkeletalMeshLODRenderData& SrcLODData, const TArray<FMatrix>& BoneMatrices, TMap<FName, TArray<FMorphTargetDelta>>& MorphMap)
+{
+	RSMG_SCOPE_CYCLE_COUNTER(STAT_RSMG_RebindVertices);
+
+	const FSkinWeightVertexBuffer& SkinWeightBuffer = *SrcLODData.GetSkinWeightVertexBuffer();
+	const uint32 MaxBoneInfluences = SkinWeightBuffer.GetMaxBoneInfluences();
+
+	for (TPair<FName, TArray<FMorphTargetDelta>>& Morph : MorphMap)
+	{
+		for (FMorphTargetDelta& Delta : Morph.Value)
+		{
+			int32 SectionIdx = INDEX_NONE;
+			int32 SectionVertIdx = INDEX_NONE;
+			SrcLODData.GetSectionFromVertexIndex(Delta.SourceIdx, SectionIdx, SectionVertIdx);
+			if (!SrcLODData.RenderSections.IsValidIndex(SectionIdx))
+			{
+				continue;
+			}
+
+			VectorRegister Rows[4];
+			BlendRebindMatrices(SkinWeightBuffer.GetVertexSkinWeights(Delta.SourceIdx), MaxBoneInfluences, SrcLODData.RenderSections[SectionIdx].BoneMap, BoneMatrices, Rows);
+			VectorStoreFloat3(TransformRebindDirection(VectorLoadFloat3(&Delta.PositionDelta), Rows), &Delta.PositionDelta);
+			VectorStoreFloat3(TransformRebindDirection(VectorLoadFloat3(&Delta.TangentZDelta), Rows), &Delta.TangentZDelta);
+		}
+	}
+}
@@ -104,13 +104,17 @@ class FRuntimeSkeletalMeshGenerator
 public: // ----------------------------------------------------------------- API
 	/**
 	 * Generate the `SkeletalMesh` for the given surfaces.
+	 * `BoneTransformsOverride` replaces the reference pose of the named bones, relative to their parent,
+	 * and the vertices are skinned into that new bind pose.
 	 */
 	static void GenerateSkeletalMesh(
 		USkeletalMesh* SkeletalMesh,
 		USkeletalMesh* SourceMesh,
 		TArray<FMeshSurface>& Surfaces,
 		const TArray<UMaterialInterface*>& SurfacesMaterial,
-		const TMap<FName, FTransform>& BoneTransformsOverride = TMap<FName, FTransform>());
+		const TMap<FName, FTransform>& BoneTransformsOverride = TMap<FName, FTransform>(),
+		/// Morphs of the `SourceMesh`, as returned by `DecomposeSkeletalMesh`, rotated into the new bind pose.
+		TMap<FName, TArray<FMorphTargetDelta>>* InOutMorphMap = nullptr);
 
 	/**
 	 * Decompose the `USkeletalMesh` in `Surfaces`.
@@ -193,16 +197,33 @@ private:
 		{}
 	};
 
+	/** source vertex attributes skinned into the overridden bind pose, indexed like the source LOD render data */
+	struct FRebindVertexData
+	{
+		TArray<FVector4> Positions;
+		TArray<FVector4> TangentsX;
+		/** W holds the binormal sign */
+		TArray<FVector4> TangentsZ;
+		/** bounds of the rebound positions */
+		FBox Bounds;
+	};
+
 	template <typename VertexDataType>
-	static void GenerateLODModel(USkeletalMesh* MergeMesh, USkeletalMesh* SourceMesh, const TArray<FMeshSurface>& Surfaces, TArray<int32> SectionRemapping, int32 LODIdx);
+	static void GenerateLODModel(USkeletalMesh* MergeMesh, USkeletalMesh* SourceMesh, const TArray<FMeshSurface>& Surfaces, TArray<int32> SectionRemapping, int32 LODIdx, const FRebindVertexData* RebindData);
 
 	static void MergeBoneMap(TArray<FBoneIndexType>& MergedBoneMap, TArray<FBoneIndexType>& BoneMapToMergedBoneMap, const TArray<FBoneIndexType>& BoneMap);
 	static void BoneMapToNewRefSkel(const TArray<FBoneIndexType>& InBoneMap, const TArray<int32>& SrcToDestRefSkeletonMap, TArray<FBoneIndexType>& OutBoneMap);
 	static void GenerateNewSectionArray(USkeletalMesh* SrcMesh, TArray<int32>& SectionRemapingContainer, TArray<FCMNewSectionInfo>& NewSectionArray, int32 LODIdx);
 
+	static void GenerateDuplicatedVertices(FSkelMeshRenderSection& Section, const FCMNewSectionInfo& NewSectionInfo);
+
 	template <typename VertexDataType>
 	static void CopyVertexFromSource(VertexDataType& DestVert, const FSkeletalMeshLODRenderData& SrcLODData, const TArray<FMeshSurface>& Surfaces, int32 SourceVertIdx,
-		const FCMMergeSectionInfo& MergeSectionInfo);
+		const FCMMergeSectionInfo& MergeSectionInfo, const FRebindVertexData* RebindData);
 	
-	static void InitializeSkeleton(USkeletalMesh* MergeMesh, USkeletalMesh* SrcMesh);
+	static void InitializeSkeleton(USkeletalMesh* MergeMesh, USkeletalMesh* SrcMesh, const TMap<FName, FTransform>& BoneTransformsOverride);
+
+	static bool ComputeRebindMatrices(const FReferenceSkeleton& SrcRefSkeleton, const FReferenceSkeleton& RefSkeleton, TArray<FMatrix>& OutBoneMatrices);
+	static void RebindVertices(const FSkeletalMeshLODRenderData& SrcLODData, const TArray<FMeshSurface>& Surfaces, const TArray<FMatrix>& BoneMatrices, FRebindVertexData& OutVertexData);
+	static void RebindMorphDeltas(const FSkeletalMeshLODRenderData& SrcLODData, const TArray<FMatrix>& BoneMatrices, TMap<FName, TArray<FMorphTargetDelta>>& MorphMap);
 };
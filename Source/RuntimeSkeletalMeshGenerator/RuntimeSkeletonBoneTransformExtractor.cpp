@@ -1,29 +1,26 @@
 ﻿#include "RuntimeSkeletonBoneTransformExtractor.h"
 
 #include "Animation/Skeleton.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogRuntimeSkeletonBoneTransform, Log, All);
 
 FRuntimeSkeletonBoneTransformExtractor::FRuntimeSkeletonBoneTransformExtractor(
 	const FReferenceSkeleton& InRefSkeleton,
 	const TMap<FName, FTransform>& PoseOffsets)
 	: RefSkeleton(InRefSkeleton)
 {
-	const TArray<FTransform>& BoneTransforms = InRefSkeleton.GetRawRefBonePose();
+	TArray<FMatrix> OffsetMatrices;
+	TArray<const FMatrix*> BoneOffsets;
+	ResolvePoseOffsets(InRefSkeleton, PoseOffsets, OffsetMatrices, BoneOffsets);
 
-	GlobalBoneTransforms.Init(FMatrix::Identity, BoneTransforms.Num());
+	TArray<FMatrix> LocalTransforms;
+	GetLocalTransforms(InRefSkeleton, LocalTransforms);
 
-	TArray<bool> HasGlobalTransform;
-	HasGlobalTransform.Init(false, BoneTransforms.Num());
-
-	for (int32 i = 0; i < BoneTransforms.Num(); i += 1)
-	{
-		ComputeGlobalTransform(
-			i,
-			BoneTransforms,
-			PoseOffsets,
-			GlobalBoneTransforms,
-			HasGlobalTransform,
-			InRefSkeleton);
-	}
+	GlobalBoneTransforms.SetNumUninitialized(InRefSkeleton.GetRawBoneNum());
+	ComputeGlobalTransforms(InRefSkeleton, LocalTransforms, BoneOffsets, GlobalBoneTransforms.GetData());
 }
 
 /// Returns the Bone Transform, fetching it by BoneIndex.
@@ -42,7 +39,7 @@ FMatrix FRuntimeSkeletonBoneTransformExtractor::GetGlobalTransform(const FName B
 	}
 	else
 	{
-		return GetGlobalTransform(RefSkeleton.FindBoneIndex(BoneName));
+		return GetGlobalTransform(BoneIndex);
 	}
 }
 
@@ -51,43 +48,236 @@ uint32 FRuntimeSkeletonBoneTransformExtractor::GetBoneNum() const
 	return GlobalBoneTransforms.Num();
 }
 
-FMatrix FRuntimeSkeletonBoneTransformExtractor::ComputeGlobalTransform(
-	const int32 BoneIndex,
-	const TArray<FTransform>& LocalTransforms,
+void FRuntimeSkeletonBoneTransformExtractor::ResolvePoseOffsets(
+	const FReferenceSkeleton& InRefSkeleton,
 	const TMap<FName, FTransform>& PoseOffsets,
-	TArray<FMatrix>& GlobalTransforms,
-	TArray<bool>& HasGlobalTransform,
-	const FReferenceSkeleton& InRefSkeleton)
+	TArray<FMatrix>& OutOffsetMatrices,
+	TArray<const FMatrix*>& OutBoneOffsets)
 {
-	if (BoneIndex == INDEX_NONE)
+	OutBoneOffsets.Init(nullptr, InRefSkeleton.GetRawBoneNum());
+
+	// Sized up front, so the pointers to the matrices stay valid.
+	OutOffsetMatrices.Reset(PoseOffsets.Num());
+	for (const TPair<FName, FTransform>& PoseOffset : PoseOffsets)
 	{
-		return FMatrix::Identity;
+		const int32 BoneIndex = InRefSkeleton.FindRawBoneIndex(PoseOffset.Key);
+		if (BoneIndex != INDEX_NONE)
+		{
+			OutBoneOffsets[BoneIndex] = &OutOffsetMatrices.Add_GetRef(PoseOffset.Value.ToMatrixWithScale());
+		}
 	}
+}
+
+void FRuntimeSkeletonBoneTransformExtractor::GetLocalTransforms(
+	const FReferenceSkeleton& InRefSkeleton,
+	TArray<FMatrix>& OutLocalTransforms)
+{
+	const TArray<FTransform>& BoneTransforms = InRefSkeleton.GetRawRefBonePose();
 
-	if (HasGlobalTransform[BoneIndex])
+	OutLocalTransforms.SetNumUninitialized(BoneTransforms.Num());
+	for (int32 BoneIndex = 0; BoneIndex < BoneTransforms.Num(); BoneIndex += 1)
 	{
-		return GlobalTransforms[BoneIndex];
+		OutLocalTransforms[BoneIndex] = BoneTransforms[BoneIndex].ToMatrixWithScale();
 	}
+}
+
+void FRuntimeSkeletonBoneTransformExtractor::ComputeGlobalTransforms(
+	const FReferenceSkeleton& InRefSkeleton,
+	const TArray<FMatrix>& LocalTransforms,
+	const TArray<const FMatrix*>& BoneOffsets,
+	FMatrix* OutGlobalTransforms)
+{
+	const TArray<FMeshBoneInfo>& BoneInfos = InRefSkeleton.GetRawRefBoneInfo();
+
+	for (int32 BoneIndex = 0; BoneIndex < LocalTransforms.Num(); BoneIndex += 1)
+	{
+		FMatrix& GlobalTransform = OutGlobalTransforms[BoneIndex];
+
+		const int32 ParentIndex = BoneInfos[BoneIndex].ParentIndex;
+		if (ParentIndex == INDEX_NONE)
+		{
+			GlobalTransform = LocalTransforms[BoneIndex];
+		}
+		else
+		{
+			checkSlow(ParentIndex < BoneIndex);
+			VectorMatrixMultiply(&GlobalTransform, &LocalTransforms[BoneIndex], &OutGlobalTransforms[ParentIndex]);
+		}
 
-	const FName BoneName = InRefSkeleton.GetBoneName(BoneIndex);
-	const int32 ParentIndex = InRefSkeleton.GetParentIndex(BoneIndex);
+		if (const FMatrix* PoseOffset = BoneOffsets[BoneIndex])
+		{
+			const FMatrix PosedTransform = GlobalTransform;
+			VectorMatrixMultiply(&GlobalTransform, PoseOffset, &PosedTransform);
+		}
+	}
+}
+
+FRuntimeSkeletonBoneTransformBatch::FRuntimeSkeletonBoneTransformBatch(
+	const FReferenceSkeleton& InRefSkeleton,
+	TArrayView<const TMap<FName, FTransform>> PoseOffsets)
+	: RefSkeleton(InRefSkeleton)
+	, CharacterNum(PoseOffsets.Num())
+{
+	// Shared by every character.
+	TArray<FMatrix> LocalTransforms;
+	FRuntimeSkeletonBoneTransformExtractor::GetLocalTransforms(InRefSkeleton, LocalTransforms);
+	const TArray<FMeshBoneInfo>& BoneInfos = InRefSkeleton.GetRawRefBoneInfo();
+	const int32 BoneNum = LocalTransforms.Num();
 
-	const FMatrix ParentBoneTransform = ComputeGlobalTransform(
-		ParentIndex,
-		LocalTransforms,
-		PoseOffsets,
-		GlobalTransforms,
-		HasGlobalTransform,
-		InRefSkeleton);
+	GlobalBoneTransforms.SetNumUninitialized(BoneNum * CharacterNum);
 
-	GlobalTransforms[BoneIndex] = LocalTransforms[BoneIndex].ToMatrixWithScale() * ParentBoneTransform;
+	// Characters of a range are contiguous in every bone row, one matrix is one cache line.
+	constexpr int32 RangeCharacterNum = 64;
+	const int32 RangeNum = FMath::DivideAndRoundUp(CharacterNum, RangeCharacterNum);
 
-	if (const FTransform* PoseOffset = PoseOffsets.Find(BoneName))
+	ParallelFor(RangeNum, [&](const int32 RangeIndex)
 	{
-		GlobalTransforms[BoneIndex] = PoseOffset->ToMatrixWithScale() * GlobalTransforms[BoneIndex];
+		const int32 FirstCharacter = RangeIndex * RangeCharacterNum;
+		const int32 LastCharacter = FMath::Min(FirstCharacter + RangeCharacterNum, CharacterNum);
+
+		// The pose offsets of the range, in bone order, resolved into one buffer.
+		struct FBoneOffset
+		{
+			FMatrix Offset;
+			int32 BoneIndex;
+			int32 CharacterIndex;
+		};
+		int32 OffsetNum = 0;
+		for (int32 CharacterIndex = FirstCharacter; CharacterIndex < LastCharacter; CharacterIndex += 1)
+		{
+			OffsetNum += PoseOffsets[CharacterIndex].Num();
+		}
+		TArray<FBoneOffset> BoneOffsets;
+		BoneOffsets.Reserve(OffsetNum);
+		for (int32 CharacterIndex = FirstCharacter; CharacterIndex < LastCharacter; CharacterIndex += 1)
+		{
+			for (const TPair<FName, FTransform>& PoseOffset : PoseOffsets[CharacterIndex])
+			{
+				const int32 BoneIndex = InRefSkeleton.FindRawBoneIndex(PoseOffset.Key);
+				if (BoneIndex != INDEX_NONE)
+				{
+					BoneOffsets.Add({ PoseOffset.Value.ToMatrixWithScale(), BoneIndex, CharacterIndex });
+				}
+			}
+		}
+		BoneOffsets.StableSort([](const FBoneOffset& A, const FBoneOffset& B) { return A.BoneIndex < B.BoneIndex; });
+
+		// Bone outer, character inner: every step streams through contiguous rows.
+		int32 NextOffset = 0;
+		for (int32 BoneIndex = 0; BoneIndex < BoneNum; BoneIndex += 1)
+		{
+			FMatrix* Row = GlobalBoneTransforms.GetData() + BoneIndex * CharacterNum;
+			const FMatrix& LocalTransform = LocalTransforms[BoneIndex];
+
+			const int32 ParentIndex = BoneInfos[BoneIndex].ParentIndex;
+			if (ParentIndex == INDEX_NONE)
+			{
+				for (int32 CharacterIndex = FirstCharacter; CharacterIndex < LastCharacter; CharacterIndex += 1)
+				{
+					Row[CharacterIndex] = LocalTransform;
+				}
+			}
+			else
+			{
+				checkSlow(ParentIndex < BoneIndex);
+				const FMatrix* ParentRow = GlobalBoneTransforms.GetData() + ParentIndex * CharacterNum;
+				for (int32 CharacterIndex = FirstCharacter; CharacterIndex < LastCharacter; CharacterIndex += 1)
+				{
+					VectorMatrixMultiply(&Row[CharacterIndex], &LocalTransform, &ParentRow[CharacterIndex]);
+				}
+			}
+
+			for (; NextOffset < BoneOffsets.Num() && BoneOffsets[NextOffset].BoneIndex == BoneIndex; NextOffset += 1)
+			{
+				const FBoneOffset& BoneOffset = BoneOffsets[NextOffset];
+				const FMatrix PosedTransform = Row[BoneOffset.CharacterIndex];
+				VectorMatrixMultiply(&Row[BoneOffset.CharacterIndex], &BoneOffset.Offset, &PosedTransform);
+			}
+		}
+	});
+}
+
+/// Returns the Bone Transform of a character, fetching it by BoneIndex.
+const FMatrix& FRuntimeSkeletonBoneTransformBatch::GetGlobalTransform(const int32 CharacterIndex, const int32 BoneIndex) const
+{
+	checkSlow(CharacterIndex >= 0 && CharacterIndex < CharacterNum);
+	return GlobalBoneTransforms[BoneIndex * CharacterNum + CharacterIndex];
+}
+
+/// Returns the Bone Transform of every character, contiguous.
+TArrayView<const FMatrix> FRuntimeSkeletonBoneTransformBatch::GetGlobalTransforms(const int32 BoneIndex) const
+{
+	return TArrayView<const FMatrix>(GlobalBoneTransforms.GetData() + BoneIndex * CharacterNum, CharacterNum);
+}
+
+int32 FRuntimeSkeletonBoneTransformBatch::GetCharacterNum() const
+{
+	return CharacterNum;
+}
+
+uint32 FRuntimeSkeletonBoneTransformBatch::GetBoneNum() const
+{
+	return CharacterNum > 0 ? GlobalBoneTransforms.Num() / CharacterNum : RefSkeleton.GetRawBoneNum();
+}
+
+#if !UE_BUILD_SHIPPING
+/// Times one extractor per character against one batch, at 1k and 10k characters.
+static void BenchmarkBoneTransformExtraction(const TArray<FString>& Args)
+{
+	const int32 NumBones = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 128;
+	const int32 NumOffsetsPerCharacter = Args.Num() > 1 ? FMath::Clamp(FCString::Atoi(*Args[1]), 0, NumBones) : 8;
+
+	// A balanced tree of bones, parents before their children.
+	FReferenceSkeleton RefSkeleton;
+	{
+		FReferenceSkeletonModifier RefSkelModifier(RefSkeleton, nullptr);
+		for (int32 BoneIndex = 0; BoneIndex < NumBones; BoneIndex += 1)
+		{
+			const FName BoneName(*FString::Printf(TEXT("Bone_%d"), BoneIndex));
+			const int32 ParentIndex = BoneIndex > 0 ? (BoneIndex - 1) / 2 : INDEX_NONE;
+			RefSkelModifier.Add(
+				FMeshBoneInfo(BoneName, BoneName.ToString(), ParentIndex),
+				FTransform(FRotator(0.f, 10.f, 0.f), FVector(0.f, 0.f, 10.f)));
+		}
 	}
 
-	HasGlobalTransform[BoneIndex] = true;
+	for (const int32 NumCharacters : { 1000, 10000 })
+	{
+		FRandomStream RandomStream(NumCharacters);
+		TArray<TMap<FName, FTransform>> PoseOffsets;
+		PoseOffsets.SetNum(NumCharacters);
+		for (TMap<FName, FTransform>& CharacterOffsets : PoseOffsets)
+		{
+			for (int32 OffsetIndex = 0; OffsetIndex < NumOffsetsPerCharacter; OffsetIndex += 1)
+			{
+				const int32 BoneIndex = RandomStream.RandHelper(NumBones);
+				CharacterOffsets.Add(
+					RefSkeleton.GetBoneName(BoneIndex),
+					FTransform(FRotator(RandomStream.FRandRange(-30.f, 30.f), 0.f, 0.f), RandomStream.GetUnitVector()));
+			}
+		}
+
+		double StartTime = FPlatformTime::Seconds();
+		for (const TMap<FName, FTransform>& CharacterOffsets : PoseOffsets)
+		{
+			const FRuntimeSkeletonBoneTransformExtractor Extractor(RefSkeleton, CharacterOffsets);
+		}
+		const double ExtractorSeconds = FPlatformTime::Seconds() - StartTime;
 
-	return GlobalTransforms[BoneIndex];
+		StartTime = FPlatformTime::Seconds();
+		const FRuntimeSkeletonBoneTransformBatch Batch(RefSkeleton, PoseOffsets);
+		const double BatchSeconds = FPlatformTime::Seconds() - StartTime;
+
+		UE_LOG(LogRuntimeSkeletonBoneTransform, Display, TEXT("%d characters x %d bones: extractor per character %.2fms (%.0f characters/s), batch %.2fms (%.0f characters/s)"),
+			NumCharacters, NumBones,
+			ExtractorSeconds * 1000.0, ExtractorSeconds > 0.0 ? NumCharacters / ExtractorSeconds : 0.0,
+			BatchSeconds * 1000.0, BatchSeconds > 0.0 ? NumCharacters / BatchSeconds : 0.0);
+	}
 }
+
+static FAutoConsoleCommand GBenchmarkBoneTransformExtractionCmd(
+	TEXT("RuntimeSkeletalMeshGenerator.BenchmarkBoneTransforms"),
+	TEXT("Times the global bone transform extraction of 1k and 10k characters, one extractor per character against one batch.\n")
+	TEXT("Usage: RuntimeSkeletalMeshGenerator.BenchmarkBoneTransforms [NumBones=128] [NumOffsetsPerCharacter=8]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkBoneTransformExtraction));
+#endif
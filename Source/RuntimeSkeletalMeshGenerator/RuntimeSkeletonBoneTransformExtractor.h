@@ -8,6 +8,8 @@ struct FReferenceSkeleton;
 /// Eventually you can pose the skeleton before extracting the final Bone transform.
 class FRuntimeSkeletonBoneTransformExtractor
 {
+	friend class FRuntimeSkeletonBoneTransformBatch;
+
 	const FReferenceSkeleton& RefSkeleton;
 	TArray<FMatrix> GlobalBoneTransforms;
 
@@ -25,11 +27,51 @@ public:
 	uint32 GetBoneNum() const;
 
 private:
-	static FMatrix ComputeGlobalTransform(
-		const int32 BoneIndex,
-		const TArray<FTransform>& LocalTransforms,
+	/// Resolves the pose offsets to the bones they apply to.
+	/// `OutBoneOffsets` gets one entry per bone, null for the bones without an offset.
+	static void ResolvePoseOffsets(
+		const FReferenceSkeleton& InRefSkeleton,
 		const TMap<FName, FTransform>& PoseOffsets,
-		TArray<FMatrix>& GlobalTransforms,
-		TArray<bool>& HasGlobalTransform,
-		const FReferenceSkeleton& InRefSkeleton);
+		TArray<FMatrix>& OutOffsetMatrices,
+		TArray<const FMatrix*>& OutBoneOffsets);
+
+	/// Returns the local reference pose of every bone as a matrix.
+	static void GetLocalTransforms(
+		const FReferenceSkeleton& InRefSkeleton,
+		TArray<FMatrix>& OutLocalTransforms);
+
+	/// Computes the global transform of every bone in a single pass,
+	/// `FReferenceSkeleton` stores the parents before their children.
+	static void ComputeGlobalTransforms(
+		const FReferenceSkeleton& InRefSkeleton,
+		const TArray<FMatrix>& LocalTransforms,
+		const TArray<const FMatrix*>& BoneOffsets,
+		FMatrix* OutGlobalTransforms);
+};
+
+/// Fetches the bone world transforms of many characters sharing one reference skeleton,
+/// each posed with its own offsets.
+/// The skeleton is traversed once per range of characters, the ranges are computed in parallel.
+class FRuntimeSkeletonBoneTransformBatch
+{
+	const FReferenceSkeleton& RefSkeleton;
+	int32 CharacterNum;
+	/// Bone major: the transforms of bone `i` for every character start at `i * CharacterNum`.
+	/// Cache line aligned, so the ranges of characters computed in parallel never share a line.
+	TArray<FMatrix, TAlignedHeapAllocator<PLATFORM_CACHE_LINE_SIZE>> GlobalBoneTransforms;
+
+public:
+	FRuntimeSkeletonBoneTransformBatch(
+		const FReferenceSkeleton& InRefSkeleton,
+		TArrayView<const TMap<FName, FTransform>> PoseOffsets);
+
+	/// Returns the Bone Transform of a character, fetching it by BoneIndex.
+	const FMatrix& GetGlobalTransform(const int32 CharacterIndex, const int32 BoneIndex) const;
+
+	/// Returns the Bone Transform of every character, contiguous.
+	TArrayView<const FMatrix> GetGlobalTransforms(const int32 BoneIndex) const;
+
+	int32 GetCharacterNum() const;
+
+	uint32 GetBoneNum() const;
 };